@@ -0,0 +1,69 @@
+#include "global.hpp"
+
+void color_pairs()
+{
+	static int height = 20;
+	static int width = 50;
+
+	auto pr = tuicpp::Window::limits();
+
+	int y = (pr.first - height) / 2;
+	int x = (pr.second - width) / 2;
+
+	tuicpp::ColorPairs pairs;
+
+	auto fmt = tuicpp::NumberFormat {
+		.precision = 3,
+		.width = 8
+	};
+
+	auto value = [](const float &t, size_t column) {
+		return column == 0 ? t : (column == 1 ? std::sin(t) : std::cos(t));
+	};
+
+	auto from = tuicpp::Table <float> ::From({"t", "sin(t)", "cos(t)"},
+		[fmt, value](const float &t, size_t column) {
+			return fmt(value(t, column));
+		}
+	);
+
+	// Shade each value from blue (-1) to red (+1)
+	from.style = [&pairs, value](size_t, size_t column, const float &t) {
+		if (column == 0)
+			return A_NORMAL;
+
+		int level = (value(t, column) + 1) * 127.5;
+		auto fg = tuicpp::ColorPairs::rgb(level, 64, 255 - level);
+		return pairs(fg) | A_BOLD;
+	};
+
+	for (int i = 0; i < 500; i++)
+		from.data.push_back(i * 0.05f);
+
+	auto win = tuicpp::Table <float> (
+		from,
+		tuicpp::ScreenInfo {
+			.height = height,
+			.width = width,
+			.y = y,
+			.x = x
+		}
+	);
+
+	// Scroll with the arrow keys, q to quit
+	win.set_keypad(true);
+
+	size_t top = 0;
+	while (true) {
+		int c = win.getc();
+		if (c == 'q')
+			break;
+
+		if (c == 'j' || c == KEY_DOWN)
+			top = std::min <size_t> (top + 1, from.data.size() - 1);
+		else if ((c == 'k' || c == KEY_UP) && top > 0)
+			top--;
+
+		win.scroll_to(top);
+	}
+}
@@ -12,10 +12,11 @@ void editor_window()
 
 	std::string name = "Bob Joe";
 	std::string email;
+	int age = 30;
 
 	auto win = new tuicpp::FieldEditor(
 		"Employee Editor",
-		{"Name", "Email"},
+		{"Name", "Email", "Age"},
 		tuicpp::ScreenInfo {
 			.height = height,
 			.width = width,
@@ -26,13 +27,15 @@ void editor_window()
 
 	win->yield({
 		tuicpp::yielder(&name),
-		tuicpp::yielder(&email)
+		tuicpp::yielder(&email),
+		tuicpp::yielder(&age)
 	});
 
 	delete win;
 
 	mvprintw(y, x, "Name: %s", name.c_str());
 	mvprintw(y + 1, x, "Email: %s", email.c_str());
-	mvprintw(y + 2, x, "Press any key to quit...");
+	mvprintw(y + 2, x, "Age: %d", age);
+	mvprintw(y + 3, x, "Press any key to quit...");
 	getch();
 }
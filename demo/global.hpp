@@ -1,6 +1,7 @@
 #ifndef GLOBAL_H_
 #define GLOBAL_H_
 
+#include <clocale>
 #include <iostream>
 #include <map>
 
@@ -13,5 +14,10 @@ void selection_window();
 void multi_selection_window();
 void table_window();
 void editor_window();
+void text_area();
+void pager();
+void log_view();
+void text_view();
+void color_pairs();
 
 #endif
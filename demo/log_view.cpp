@@ -0,0 +1,60 @@
+#include "global.hpp"
+
+void log_view()
+{
+	static int height = 20;
+	static int width = 60;
+
+	auto pr = tuicpp::Window::limits();
+
+	int y = (pr.first - height) / 2;
+	int x = (pr.second - width) / 2;
+
+	auto win = new tuicpp::LogView(
+		tuicpp::ScreenInfo {
+			.height = height,
+			.width = width,
+			.y = y,
+			.x = x
+		}, 1000
+	);
+
+	win->printf("Page up and down to scroll back, q to quit...");
+
+	// Workers log through a channel, without waiting on the screen
+	tuicpp::LogChannel channel;
+	std::atomic <bool> stop {false};
+
+	std::vector <std::thread> workers;
+	for (int w = 0; w < 2; w++) {
+		workers.emplace_back([&, w]() {
+			auto log = channel.producer();
+			for (int i = 0; !stop; i++) {
+				log.printf("worker %d: request %d handled", w, i);
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+	}
+
+	noecho();
+	curs_set(0);
+	win->set_timeout(50);
+
+	// Draw once per frame, until q is pressed
+	while (true) {
+		channel.drain(*win);
+		win->flush();
+
+		int c = win->getc();
+		if (c == 'q')
+			break;
+
+		win->handle_key(c);
+	}
+
+	stop = true;
+	for (auto &worker : workers)
+		worker.join();
+
+	delete win;
+}
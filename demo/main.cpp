@@ -7,7 +7,12 @@ std::map <std::string, void (*)()> functions {
 	{"selection", selection_window},
 	{"multi_selection", multi_selection_window},
 	{"table", table_window},
-	{"editor", editor_window}
+	{"editor", editor_window},
+	{"text", text_area},
+	{"pager", pager},
+	{"log", log_view},
+	{"wrapped", text_view},
+	{"colors", color_pairs}
 };
 
 int main()
@@ -29,6 +34,7 @@ int main()
 	}
 
 	// Run window type demo
+	setlocale(LC_ALL, "");
 	initscr();
 	functions[input]();
 	endwin();
@@ -0,0 +1,29 @@
+#include "global.hpp"
+
+void pager()
+{
+	auto pr = tuicpp::Window::limits();
+
+	auto win = new tuicpp::Pager(
+		"Pager",
+		tuicpp::ScreenInfo {
+			.height = pr.first,
+			.width = pr.second,
+			.y = 0,
+			.x = 0
+		}
+	);
+
+	// Page through this repository's README
+	if (!win->open("README.md")) {
+		delete win;
+
+		mvprintw(0, 0, "Could not open README.md, run the demo from the repository");
+		mvprintw(1, 0, "Press any key to quit...");
+		getch();
+		return;
+	}
+
+	win->yield();
+	delete win;
+}
@@ -10,11 +10,16 @@ void table_window()
 	int y = (pr.first - height) / 2;
 	int x = (pr.second - width) / 2;
 
-	auto to_str = [](const float &i, size_t column) {
+	auto fmt = tuicpp::NumberFormat {
+		.precision = 3,
+		.width = 8
+	};
+
+	auto to_str = [fmt](const float &i, size_t column) {
 		if (column == 0)
-			return std::to_string(i);
+			return fmt(i);
 		else
-			return std::to_string(i * i);
+			return fmt(i * i);
 	};
 
 	auto from = tuicpp::Table <float> ::From({"x", "f(x)"}, to_str);
@@ -0,0 +1,39 @@
+#include "global.hpp"
+
+void text_area()
+{
+	static int height = 20;
+	static int width = 60;
+
+	auto pr = tuicpp::Window::limits();
+
+	int y = (pr.first - height) / 2;
+	int x = (pr.second - width) / 2;
+
+	tuicpp::TextBuffer buffer(
+		"This is a text area.\n"
+		"Lines which are longer than the width of the window are"
+		" wrapped onto the following rows.\n"
+		"\n"
+		"Press Ctrl-X to accept or escape to cancel...\n"
+	);
+
+	auto win = new tuicpp::TextArea(
+		"Text Area",
+		tuicpp::ScreenInfo {
+			.height = height,
+			.width = width,
+			.y = y,
+			.x = x
+		}
+	);
+
+	bool accepted = win->yield(buffer);
+	delete win;
+
+	mvprintw(y, x, "Accepted? %s", accepted ? "yes" : "no");
+	mvprintw(y + 1, x, "Lines: %zu, characters: %zu",
+		buffer.lines(), buffer.size());
+	mvprintw(y + 2, x, "Press any key to quit...");
+	getch();
+}
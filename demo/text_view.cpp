@@ -0,0 +1,49 @@
+#include "global.hpp"
+
+void text_view()
+{
+	static int height = 10;
+	static int width = 30;
+
+	auto pr = tuicpp::Window::limits();
+
+	int y = (pr.first - height) / 2;
+	int x = (pr.second - width) / 2;
+
+	auto win = new tuicpp::TextView(
+		tuicpp::ScreenInfo {
+			.height = height,
+			.width = width,
+			.y = y,
+			.x = x
+		},
+		"Unlike printf, a text view wraps its text at words, and"
+		" only lays out the paragraphs it shows.\n"
+		"\n"
+		"Use the arrow keys, page up and page down to scroll. The"
+		" left and right keys make the window narrower and wider,"
+		" reflowing the text in view.\n"
+		"\n"
+		"Press q to quit..."
+	);
+
+	int w = width;
+	while (true) {
+		win->draw();
+
+		int c = win->getc();
+		if (c == 'q')
+			break;
+
+		if (c == KEY_LEFT || c == KEY_RIGHT) {
+			w = std::max(10, std::min(pr.second - x, w + (c == KEY_LEFT ? -2 : 2)));
+			win->resize(height, w);
+			clear();
+			::refresh();
+		} else {
+			win->handle_key(c);
+		}
+	}
+
+	delete win;
+}
@@ -0,0 +1,74 @@
+#include <clocale>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "../tuicpp.hpp"
+
+// Pick lines read from stdin, in the manner of fzf:
+//
+//	find . | picker [-m] [-q query]
+//
+// The chosen lines are written to stdout; the exit status is 0 if
+// lines were chosen, 1 if none matched and 130 if cancelled
+int main(int argc, char *argv[])
+{
+	bool multi = false;
+	std::string query;
+
+	for (int i = 1; i < argc; i++) {
+		if (!std::strcmp(argv[i], "-m")) {
+			multi = true;
+		} else if (!std::strcmp(argv[i], "-q") && i + 1 < argc) {
+			query = argv[++i];
+		} else {
+			std::cerr << "usage: " << argv[0] << " [-m] [-q query]\n";
+			return 2;
+		}
+	}
+
+	// Stdin holds the lines, so the terminal is opened directly
+	FILE *tty = std::fopen("/dev/tty", "r+");
+	if (!tty) {
+		std::cerr << "picker: cannot open /dev/tty\n";
+		return 2;
+	}
+
+	setlocale(LC_ALL, "");
+	SCREEN *screen = newterm(nullptr, tty, tty);
+	set_term(screen);
+	cbreak();
+	noecho();
+	set_escdelay(25);
+
+	std::vector <std::string> chosen;
+	bool accepted;
+
+	{
+		auto title = multi ? "Pick lines (tab to mark)" : "Pick a line";
+		tuicpp::Picker picker(title,
+			tuicpp::ScreenInfo {
+				.height = LINES,
+				.width = COLS,
+				.y = 0,
+				.x = 0
+			}, multi
+		);
+
+		picker.set_query(query);
+		picker.read(0);
+		accepted = picker.yield(chosen);
+	}
+
+	endwin();
+	delscreen(screen);
+	std::fclose(tty);
+
+	for (const auto &line : chosen)
+		std::cout << line << '\n';
+
+	if (!accepted)
+		return 130;
+
+	return chosen.empty() ? 1 : 0;
+}
@@ -2,15 +2,44 @@
 #define TUICPP_H_
 
 // Standard headers
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
 #include <vector>
 
 // Ncurses
 #include <ncurses.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Posix
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace tuicpp {
 
 ///////////////////////////
@@ -25,6 +54,571 @@ struct ScreenInfo {
         int x;
 };
 
+// Width of UTF-8 text in terminal columns: wide (East Asian)
+//	characters take two, combining marks and other zero width
+//	characters none; the ASCII runs which make up most text are
+//	found a vector (or a word) at a time, and cost a column per
+//	byte. Bytes which are not valid UTF-8 take a column each
+struct DisplayWidth {
+	struct Range {
+		char32_t first;
+		char32_t last;
+	};
+
+	// Bytes of ASCII at the start of a text
+	static size_t ascii(std::string_view text) {
+		const char *data = text.data();
+		size_t size = text.size();
+		size_t i = 0;
+
+#ifdef __SSE2__
+		for (; i + 16 <= size; i += 16) {
+			__m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+			if (_mm_movemask_epi8(v))
+				break;
+		}
+#endif
+
+		for (; i + 8 <= size; i += 8) {
+			uint64_t word;
+			std::memcpy(&word, data + i, 8);
+			if (word & 0x8080808080808080ull)
+				break;
+		}
+
+		while (i < size && !(data[i] & 0x80))
+			i++;
+
+		return i;
+	}
+
+	// Decode the character at an offset, returns its length in
+	//	bytes, or 0 if it is not valid UTF-8 (overlong encodings
+	//	and surrogates included)
+	static size_t decode(std::string_view text, size_t i, char32_t &cp) {
+		unsigned char c = text[i];
+		if (c < 0x80) {
+			cp = c;
+			return 1;
+		}
+
+		size_t length;
+		char32_t min;
+		if ((c & 0xE0) == 0xC0)
+			length = 2, cp = c & 0x1F, min = 0x80;
+		else if ((c & 0xF0) == 0xE0)
+			length = 3, cp = c & 0x0F, min = 0x800;
+		else if ((c & 0xF8) == 0xF0)
+			length = 4, cp = c & 0x07, min = 0x10000;
+		else
+			return 0;
+
+		if (text.size() - i < length)
+			return 0;
+
+		for (size_t k = 1; k < length; k++) {
+			unsigned char b = text[i + k];
+			if ((b & 0xC0) != 0x80)
+				return 0;
+
+			cp = (cp << 6) | (b & 0x3F);
+		}
+
+		if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+			return 0;
+
+		return length;
+	}
+
+	// Check that a text is valid UTF-8
+	static bool valid(std::string_view text) {
+		size_t i = 0;
+		while (true) {
+			i += ascii(text.substr(i));
+			if (i == text.size())
+				return true;
+
+			char32_t cp;
+			size_t length = decode(text, i, cp);
+			if (!length)
+				return false;
+
+			i += length;
+		}
+	}
+
+	// Columns of a character
+	static int of(char32_t cp) {
+		if (cp < 0x300)
+			return 1;
+
+		if (cp < 0x10000)
+			return _plane()[cp];
+
+		if (_find(_zero, cp))
+			return 0;
+
+		return _find(_wide, cp) ? 2 : 1;
+	}
+
+	// Columns of a text
+	static size_t columns(std::string_view text) {
+		size_t n = 0;
+		size_t i = 0;
+		while (true) {
+			size_t run = ascii(text.substr(i));
+			n += run;
+			i += run;
+			if (i == text.size())
+				return n;
+
+			char32_t cp;
+			size_t length = decode(text, i, cp);
+			n += length ? of(cp) : 1;
+			i += length ? length : 1;
+		}
+	}
+
+	// Bytes of the longest start of a text which fits in some
+	//	columns, without splitting a character
+	static size_t prefix(std::string_view text, size_t columns) {
+		size_t n = 0;
+		size_t i = 0;
+		while (true) {
+			size_t run = std::min(ascii(text.substr(i)), columns - n);
+			n += run;
+			i += run;
+			if (i == text.size() || (n == columns && !(text[i] & 0x80)))
+				return i;
+
+			char32_t cp;
+			size_t length = decode(text, i, cp);
+			size_t w = length ? of(cp) : 1;
+			if (n + w > columns)
+				return i;
+
+			n += w;
+			i += length ? length : 1;
+		}
+	}
+
+	// Control characters (C0 and DEL), drawn as spaces; the
+	//	widths above count them as a column
+	static bool control(char c) {
+		return (unsigned char) c < 32 || c == 127;
+	}
+protected:
+	// Columns of the characters of the basic multilingual plane,
+	//	looked up once in the ranges
+	static const uint8_t *_plane() {
+		static const std::vector <uint8_t> plane = []() {
+			std::vector <uint8_t> table(0x10000, 1);
+			for (const auto &r : _zero) {
+				for (char32_t cp = r.first; cp <= r.last && cp < 0x10000; cp++)
+					table[cp] = 0;
+			}
+
+			for (const auto &r : _wide) {
+				for (char32_t cp = r.first; cp <= r.last && cp < 0x10000; cp++)
+					table[cp] = 2;
+			}
+
+			return table;
+		}();
+
+		return plane.data();
+	}
+
+	template <size_t N>
+	static bool _find(const Range (&ranges)[N], char32_t cp) {
+		auto it = std::upper_bound(ranges, ranges + N, cp,
+			[](char32_t c, const Range &r) { return c < r.first; });
+
+		return it != ranges && cp <= (it - 1)->last;
+	}
+
+	// Combining marks, format characters (except the visible ones
+	//	prepended to numbers) and Hangul medial vowels, which take
+	//	no column
+	static constexpr Range _zero[] = {
+		{0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD},
+		{0x05BF, 0x05BF}, {0x05C1, 0x05C2}, {0x05C4, 0x05C5},
+		{0x05C7, 0x05C7}, {0x0610, 0x061A}, {0x061C, 0x061C},
+		{0x064B, 0x065F}, {0x0670, 0x0670}, {0x06D6, 0x06DC},
+		{0x06DF, 0x06E4}, {0x06E7, 0x06E8}, {0x06EA, 0x06ED},
+		{0x0711, 0x0711}, {0x0730, 0x074A}, {0x07A6, 0x07B0},
+		{0x07EB, 0x07F3}, {0x07FD, 0x07FD}, {0x0816, 0x0819},
+		{0x081B, 0x0823}, {0x0825, 0x0827}, {0x0829, 0x082D},
+		{0x0859, 0x085B}, {0x0898, 0x089F}, {0x08CA, 0x08E1},
+		{0x08E3, 0x0902}, {0x093A, 0x093A}, {0x093C, 0x093C},
+		{0x0941, 0x0948}, {0x094D, 0x094D}, {0x0951, 0x0957},
+		{0x0962, 0x0963}, {0x0981, 0x0981}, {0x09BC, 0x09BC},
+		{0x09C1, 0x09C4}, {0x09CD, 0x09CD}, {0x09E2, 0x09E3},
+		{0x09FE, 0x0A02}, {0x0A3C, 0x0A3C}, {0x0A41, 0x0A51},
+		{0x0A70, 0x0A71}, {0x0A75, 0x0A75}, {0x0A81, 0x0A82},
+		{0x0ABC, 0x0ABC}, {0x0AC1, 0x0AC8}, {0x0ACD, 0x0ACD},
+		{0x0AE2, 0x0AE3}, {0x0AFA, 0x0B01}, {0x0B3C, 0x0B3C},
+		{0x0B3F, 0x0B3F}, {0x0B41, 0x0B44}, {0x0B4D, 0x0B56},
+		{0x0B62, 0x0B63}, {0x0B82, 0x0B82}, {0x0BC0, 0x0BC0},
+		{0x0BCD, 0x0BCD}, {0x0C00, 0x0C00}, {0x0C04, 0x0C04},
+		{0x0C3C, 0x0C3C}, {0x0C3E, 0x0C40}, {0x0C46, 0x0C56},
+		{0x0C62, 0x0C63}, {0x0C81, 0x0C81}, {0x0CBC, 0x0CBC},
+		{0x0CBF, 0x0CBF}, {0x0CC6, 0x0CC6}, {0x0CCC, 0x0CCD},
+		{0x0CE2, 0x0CE3}, {0x0D00, 0x0D01}, {0x0D3B, 0x0D3C},
+		{0x0D41, 0x0D44}, {0x0D4D, 0x0D4D}, {0x0D62, 0x0D63},
+		{0x0D81, 0x0D81}, {0x0DCA, 0x0DCA}, {0x0DD2, 0x0DD6},
+		{0x0E31, 0x0E31}, {0x0E34, 0x0E3A}, {0x0E47, 0x0E4E},
+		{0x0EB1, 0x0EB1}, {0x0EB4, 0x0EBC}, {0x0EC8, 0x0ECD},
+		{0x0F18, 0x0F19}, {0x0F35, 0x0F35}, {0x0F37, 0x0F37},
+		{0x0F39, 0x0F39}, {0x0F71, 0x0F7E}, {0x0F80, 0x0F84},
+		{0x0F86, 0x0F87}, {0x0F8D, 0x0FBC}, {0x0FC6, 0x0FC6},
+		{0x102D, 0x1030}, {0x1032, 0x1037}, {0x1039, 0x103A},
+		{0x103D, 0x103E}, {0x1058, 0x1059}, {0x105E, 0x1060},
+		{0x1071, 0x1074}, {0x1082, 0x1082}, {0x1085, 0x1086},
+		{0x108D, 0x108D}, {0x109D, 0x109D}, {0x1160, 0x11FF},
+		{0x135D, 0x135F}, {0x1712, 0x1714}, {0x1732, 0x1733},
+		{0x1752, 0x1753}, {0x1772, 0x1773}, {0x17B4, 0x17B5},
+		{0x17B7, 0x17BD}, {0x17C6, 0x17C6}, {0x17C9, 0x17D3},
+		{0x17DD, 0x17DD}, {0x180B, 0x180F}, {0x1885, 0x1886},
+		{0x18A9, 0x18A9}, {0x1920, 0x1922}, {0x1927, 0x1928},
+		{0x1932, 0x1932}, {0x1939, 0x193B}, {0x1A17, 0x1A18},
+		{0x1A1B, 0x1A1B}, {0x1A56, 0x1A56}, {0x1A58, 0x1A60},
+		{0x1A62, 0x1A62}, {0x1A65, 0x1A6C}, {0x1A73, 0x1A7F},
+		{0x1AB0, 0x1B03}, {0x1B34, 0x1B34}, {0x1B36, 0x1B3A},
+		{0x1B3C, 0x1B3C}, {0x1B42, 0x1B42}, {0x1B6B, 0x1B73},
+		{0x1B80, 0x1B81}, {0x1BA2, 0x1BA5}, {0x1BA8, 0x1BA9},
+		{0x1BAB, 0x1BAD}, {0x1BE6, 0x1BE6}, {0x1BE8, 0x1BE9},
+		{0x1BED, 0x1BED}, {0x1BEF, 0x1BF1}, {0x1C2C, 0x1C33},
+		{0x1C36, 0x1C37}, {0x1CD0, 0x1CD2}, {0x1CD4, 0x1CE0},
+		{0x1CE2, 0x1CE8}, {0x1CED, 0x1CED}, {0x1CF4, 0x1CF4},
+		{0x1CF8, 0x1CF9}, {0x1DC0, 0x1DFF}, {0x200B, 0x200F},
+		{0x202A, 0x202E}, {0x2060, 0x206F}, {0x20D0, 0x20F0},
+		{0x2CEF, 0x2CF1}, {0x2D7F, 0x2D7F}, {0x2DE0, 0x2DFF},
+		{0x302A, 0x302D}, {0x3099, 0x309A}, {0xA66F, 0xA672},
+		{0xA674, 0xA67D}, {0xA69E, 0xA69F}, {0xA6F0, 0xA6F1},
+		{0xA802, 0xA802}, {0xA806, 0xA806}, {0xA80B, 0xA80B},
+		{0xA825, 0xA826}, {0xA82C, 0xA82C}, {0xA8C4, 0xA8C5},
+		{0xA8E0, 0xA8F1}, {0xA8FF, 0xA8FF}, {0xA926, 0xA92D},
+		{0xA947, 0xA951}, {0xA980, 0xA982}, {0xA9B3, 0xA9B3},
+		{0xA9B6, 0xA9B9}, {0xA9BC, 0xA9BD}, {0xA9E5, 0xA9E5},
+		{0xAA29, 0xAA2E}, {0xAA31, 0xAA32}, {0xAA35, 0xAA36},
+		{0xAA43, 0xAA43}, {0xAA4C, 0xAA4C}, {0xAA7C, 0xAA7C},
+		{0xAAB0, 0xAAB0}, {0xAAB2, 0xAAB4}, {0xAAB7, 0xAAB8},
+		{0xAABE, 0xAABF}, {0xAAC1, 0xAAC1}, {0xAAEC, 0xAAED},
+		{0xAAF6, 0xAAF6}, {0xABE5, 0xABE5}, {0xABE8, 0xABE8},
+		{0xABED, 0xABED}, {0xFB1E, 0xFB1E}, {0xFE00, 0xFE0F},
+		{0xFE20, 0xFE2F}, {0xFEFF, 0xFEFF}, {0xFFF9, 0xFFFB},
+		{0x101FD, 0x101FD}, {0x102E0, 0x102E0}, {0x10376, 0x1037A},
+		{0x10A01, 0x10A0F}, {0x10A38, 0x10A3F}, {0x10AE5, 0x10AE6},
+		{0x10D24, 0x10D27}, {0x10EAB, 0x10EAC}, {0x10F46, 0x10F50},
+		{0x10F82, 0x10F85}, {0x11001, 0x11001}, {0x11038, 0x11046},
+		{0x11070, 0x11070}, {0x11073, 0x11074}, {0x1107F, 0x11081},
+		{0x110B3, 0x110B6}, {0x110B9, 0x110BA}, {0x110C2, 0x110C2},
+		{0x11100, 0x11102}, {0x11127, 0x1112B}, {0x1112D, 0x11134},
+		{0x11173, 0x11173}, {0x11180, 0x11181}, {0x111B6, 0x111BE},
+		{0x111C9, 0x111CC}, {0x111CF, 0x111CF}, {0x1122F, 0x11231},
+		{0x11234, 0x11234}, {0x11236, 0x11237}, {0x1123E, 0x1123E},
+		{0x112DF, 0x112DF}, {0x112E3, 0x112EA}, {0x11300, 0x11301},
+		{0x1133B, 0x1133C}, {0x11340, 0x11340}, {0x11366, 0x11374},
+		{0x11438, 0x1143F}, {0x11442, 0x11444}, {0x11446, 0x11446},
+		{0x1145E, 0x1145E}, {0x114B3, 0x114B8}, {0x114BA, 0x114BA},
+		{0x114BF, 0x114C0}, {0x114C2, 0x114C3}, {0x115B2, 0x115B5},
+		{0x115BC, 0x115BD}, {0x115BF, 0x115C0}, {0x115DC, 0x115DD},
+		{0x11633, 0x1163A}, {0x1163D, 0x1163D}, {0x1163F, 0x11640},
+		{0x116AB, 0x116AB}, {0x116AD, 0x116AD}, {0x116B0, 0x116B5},
+		{0x116B7, 0x116B7}, {0x1171D, 0x1171F}, {0x11722, 0x11725},
+		{0x11727, 0x1172B}, {0x1182F, 0x11837}, {0x11839, 0x1183A},
+		{0x1193B, 0x1193C}, {0x1193E, 0x1193E}, {0x11943, 0x11943},
+		{0x119D4, 0x119DB}, {0x119E0, 0x119E0}, {0x11A01, 0x11A0A},
+		{0x11A33, 0x11A38}, {0x11A3B, 0x11A3E}, {0x11A47, 0x11A47},
+		{0x11A51, 0x11A56}, {0x11A59, 0x11A5B}, {0x11A8A, 0x11A96},
+		{0x11A98, 0x11A99}, {0x11C30, 0x11C3D}, {0x11C3F, 0x11C3F},
+		{0x11C92, 0x11CA7}, {0x11CAA, 0x11CB0}, {0x11CB2, 0x11CB3},
+		{0x11CB5, 0x11CB6}, {0x11D31, 0x11D45}, {0x11D47, 0x11D47},
+		{0x11D90, 0x11D91}, {0x11D95, 0x11D95}, {0x11D97, 0x11D97},
+		{0x11EF3, 0x11EF4}, {0x13430, 0x13438}, {0x16AF0, 0x16AF4},
+		{0x16B30, 0x16B36}, {0x16F4F, 0x16F4F}, {0x16F8F, 0x16F92},
+		{0x16FE4, 0x16FE4}, {0x1BC9D, 0x1BC9E}, {0x1BCA0, 0x1CF46},
+		{0x1D167, 0x1D169}, {0x1D173, 0x1D182}, {0x1D185, 0x1D18B},
+		{0x1D1AA, 0x1D1AD}, {0x1D242, 0x1D244}, {0x1DA00, 0x1DA36},
+		{0x1DA3B, 0x1DA6C}, {0x1DA75, 0x1DA75}, {0x1DA84, 0x1DA84},
+		{0x1DA9B, 0x1DAAF}, {0x1E000, 0x1E02A}, {0x1E130, 0x1E136},
+		{0x1E2AE, 0x1E2AE}, {0x1E2EC, 0x1E2EF}, {0x1E8D0, 0x1E8D6},
+		{0x1E944, 0x1E94A}, {0xE0001, 0xE01EF}
+	};
+
+	// East Asian wide and fullwidth characters
+	static constexpr Range _wide[] = {
+		{0x1100, 0x115F}, {0x231A, 0x231B}, {0x2329, 0x232A},
+		{0x23E9, 0x23EC}, {0x23F0, 0x23F0}, {0x23F3, 0x23F3},
+		{0x25FD, 0x25FE}, {0x2614, 0x2615}, {0x2648, 0x2653},
+		{0x267F, 0x267F}, {0x2693, 0x2693}, {0x26A1, 0x26A1},
+		{0x26AA, 0x26AB}, {0x26BD, 0x26BE}, {0x26C4, 0x26C5},
+		{0x26CE, 0x26CE}, {0x26D4, 0x26D4}, {0x26EA, 0x26EA},
+		{0x26F2, 0x26F3}, {0x26F5, 0x26F5}, {0x26FA, 0x26FA},
+		{0x26FD, 0x26FD}, {0x2705, 0x2705}, {0x270A, 0x270B},
+		{0x2728, 0x2728}, {0x274C, 0x274C}, {0x274E, 0x274E},
+		{0x2753, 0x2755}, {0x2757, 0x2757}, {0x2795, 0x2797},
+		{0x27B0, 0x27B0}, {0x27BF, 0x27BF}, {0x2B1B, 0x2B1C},
+		{0x2B50, 0x2B50}, {0x2B55, 0x2B55}, {0x2E80, 0x303E},
+		{0x3041, 0x3247}, {0x3250, 0x4DBF}, {0x4E00, 0xA4C6},
+		{0xA960, 0xA97C}, {0xAC00, 0xD7A3}, {0xF900, 0xFAFF},
+		{0xFE10, 0xFE19}, {0xFE30, 0xFE6B}, {0xFF01, 0xFF60},
+		{0xFFE0, 0xFFE6}, {0x16FE0, 0x1B2FB}, {0x1F004, 0x1F004},
+		{0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A},
+		{0x1F200, 0x1F320}, {0x1F32D, 0x1F335}, {0x1F337, 0x1F37C},
+		{0x1F37E, 0x1F393}, {0x1F3A0, 0x1F3CA}, {0x1F3CF, 0x1F3D3},
+		{0x1F3E0, 0x1F3F0}, {0x1F3F4, 0x1F3F4}, {0x1F3F8, 0x1F43E},
+		{0x1F440, 0x1F440}, {0x1F442, 0x1F4FC}, {0x1F4FF, 0x1F53D},
+		{0x1F54B, 0x1F54E}, {0x1F550, 0x1F567}, {0x1F57A, 0x1F57A},
+		{0x1F595, 0x1F596}, {0x1F5A4, 0x1F5A4}, {0x1F5FB, 0x1F64F},
+		{0x1F680, 0x1F6C5}, {0x1F6CC, 0x1F6CC}, {0x1F6D0, 0x1F6D2},
+		{0x1F6D5, 0x1F6DF}, {0x1F6EB, 0x1F6EC}, {0x1F6F4, 0x1F6FC},
+		{0x1F7E0, 0x1F7F0}, {0x1F90C, 0x1F93A}, {0x1F93C, 0x1F945},
+		{0x1F947, 0x1F9FF}, {0x1FA70, 0x1FAF6}, {0x20000, 0x3FFFD}
+	};
+};
+
+// Color pairs allocated on demand, so that styles can name any
+//	colors rather than pairs set up beforehand: a palette index
+//	or a 24-bit color (quantized to the nearest color of the
+//	palette, once per color) for the foreground and background.
+//	A pair is defined with init_pair only the first time it is
+//	asked for; once the terminal's pairs run out, the least
+//	recently used one is redefined, which also recolors text
+//	already drawn with it. Pairs are numbered from 1 on, so only
+//	one ColorPairs may exist per screen, and pairs should not be
+//	defined by other means alongside it
+class ColorPairs {
+public:
+	// A palette index, none, or a color made by rgb
+	using Color = int32_t;
+
+	// Terminal's default color
+	static constexpr Color none = -1;
+
+	static constexpr Color rgb(uint8_t r, uint8_t g, uint8_t b) {
+		return truecolor | (r << 16) | (g << 8) | b;
+	}
+
+	// Starts color on the current screen, with at most
+	//	capacity pairs (there are at most 255 which fit in an
+	//	attribute, and the terminal may have fewer)
+	ColorPairs(size_t capacity = 255) {
+		if (!has_colors())
+			return;
+
+		start_color();
+		_defaults = (use_default_colors() == OK);
+
+		capacity = std::min <size_t> ({capacity, 255, (size_t) std::max(COLOR_PAIRS - 1, 0)});
+		_slots.resize(capacity);
+
+		int colors = std::min(COLORS, 256);
+		for (int i = 0; i < colors; i++)
+			_palette.push_back(_xterm(i));
+	}
+
+	// Attribute of a pair of colors (A_NORMAL if the terminal
+	//	has none); a pair asked for before costs a single hash
+	//	lookup
+	int operator()(Color fg, Color bg = none) {
+		if (_slots.empty())
+			return A_NORMAL;
+
+		uint64_t key = ((uint64_t) (uint32_t) fg << 32) | (uint32_t) bg;
+
+		auto it = _requests.find(key);
+		if (it != _requests.end()
+				&& _slots[it->second.slot].generation == it->second.generation) {
+			_touch(it->second.slot);
+			return COLOR_PAIR(it->second.slot + 1);
+		}
+
+		// Without default colors, use white on black
+		short f = quantize(fg);
+		short b = quantize(bg);
+		if (!_defaults) {
+			f = (f < 0) ? COLOR_WHITE : f;
+			b = (b < 0) ? COLOR_BLACK : b;
+		}
+
+		int slot = _assign(f, b);
+		if (_requests.size() >= memo_limit)
+			_requests.clear();
+		_requests[key] = Request {slot, _slots[slot].generation};
+
+		return COLOR_PAIR(slot + 1);
+	}
+
+	// Palette color nearest to a color (none for the default,
+	//	and for indices past the palette)
+	short quantize(Color color) {
+		if (color < 0)
+			return none;
+
+		if (!(color & truecolor)) {
+			if (color < (Color) _palette.size())
+				return color;
+			if (color >= 256)
+				return none;
+			color = truecolor | _xterm(color);
+		}
+
+		auto it = _nearest.find(color);
+		if (it != _nearest.end())
+			return it->second;
+
+		short best = 0;
+		uint32_t best_distance = UINT32_MAX;
+		for (size_t i = 0; i < _palette.size(); i++) {
+			uint32_t distance = _distance(color, _palette[i]);
+			if (distance < best_distance) {
+				best = i;
+				best_distance = distance;
+			}
+		}
+
+		if (_nearest.size() >= memo_limit)
+			_nearest.clear();
+		_nearest[color] = best;
+
+		return best;
+	}
+
+	// Pairs available, and pairs defined so far
+	size_t capacity() const {
+		return _slots.size();
+	}
+
+	size_t defined() const {
+		return _defined;
+	}
+protected:
+	// Marks a 24-bit color
+	static constexpr Color truecolor = 1 << 24;
+
+	// Entries memoized before the memos are started over
+	static constexpr size_t memo_limit = 1 << 16;
+
+	// A pair, in a list from the most to the least recently
+	//	used; the generation counts its redefinitions, so that
+	//	requests for its previous colors miss
+	struct Slot {
+		uint32_t	colors = -1;
+		uint32_t	generation = 0;
+		int		prev = -1;
+		int		next = -1;
+	};
+
+	struct Request {
+		int		slot;
+		uint32_t	generation;
+	};
+
+	std::vector <Slot> _slots;
+	int _head = -1;
+	int _tail = -1;
+	size_t _used = 0;
+	size_t _defined = 0;
+
+	// Pairs by their palette colors, and memos of requests and
+	//	of quantized colors
+	std::unordered_map <uint32_t, int> _assigned;
+	std::unordered_map <uint64_t, Request> _requests;
+	std::unordered_map <Color, short> _nearest;
+
+	// Colors of the palette
+	std::vector <uint32_t> _palette;
+	bool _defaults = false;
+
+	// Color of an xterm palette index: 16 system colors, a
+	//	6x6x6 cube and a gray ramp
+	static uint32_t _xterm(int i) {
+		static constexpr uint32_t system[] = {
+			0x000000, 0xCD0000, 0x00CD00, 0xCDCD00,
+			0x0000EE, 0xCD00CD, 0x00CDCD, 0xE5E5E5,
+			0x7F7F7F, 0xFF0000, 0x00FF00, 0xFFFF00,
+			0x5C5CFF, 0xFF00FF, 0x00FFFF, 0xFFFFFF
+		};
+
+		if (i < 16)
+			return system[i];
+
+		if (i < 232) {
+			auto level = [](int v) -> uint32_t {
+				return v ? 55 + 40 * v : 0;
+			};
+
+			i -= 16;
+			return (level(i / 36) << 16) | (level(i / 6 % 6) << 8) | level(i % 6);
+		}
+
+		uint32_t gray = 8 + 10 * (i - 232);
+		return (gray << 16) | (gray << 8) | gray;
+	}
+
+	// Distance between colors, weighted for the eye
+	static uint32_t _distance(uint32_t a, uint32_t b) {
+		int dr = (int) ((a >> 16) & 0xFF) - (int) ((b >> 16) & 0xFF);
+		int dg = (int) ((a >> 8) & 0xFF) - (int) ((b >> 8) & 0xFF);
+		int db = (int) (a & 0xFF) - (int) (b & 0xFF);
+		return 2 * dr * dr + 4 * dg * dg + 3 * db * db;
+	}
+
+	// Move a pair to the front of the list
+	void _touch(int slot) {
+		if (slot == _head)
+			return;
+
+		Slot &s = _slots[slot];
+		if (s.prev >= 0)
+			_slots[s.prev].next = s.next;
+		if (s.next >= 0)
+			_slots[s.next].prev = s.prev;
+		if (slot == _tail)
+			_tail = s.prev;
+
+		s.prev = -1;
+		s.next = _head;
+		if (_head >= 0)
+			_slots[_head].prev = slot;
+		_head = slot;
+		if (_tail < 0)
+			_tail = slot;
+	}
+
+	// Pair of two palette colors, defining it (in a free
+	//	pair, or the least recently used one) if needed
+	int _assign(short fg, short bg) {
+		uint32_t colors = ((uint32_t) (uint16_t) fg << 16) | (uint16_t) bg;
+
+		auto it = _assigned.find(colors);
+		if (it != _assigned.end()) {
+			_touch(it->second);
+			return it->second;
+		}
+
+		int slot;
+		if (_used < _slots.size()) {
+			slot = _used++;
+		} else {
+			slot = _tail;
+			_assigned.erase(_slots[slot].colors);
+			_slots[slot].generation++;
+		}
+
+		_slots[slot].colors = colors;
+		_assigned[colors] = slot;
+		_touch(slot);
+
+		init_pair(slot + 1, fg, bg);
+		_defined++;
+
+		return slot;
+	}
+};
+
 // Generic window class
 class Window {
 public:
@@ -55,6 +649,26 @@ class PlainWindow : public Window {
 protected:
 	WINDOW *_main = nullptr;
 
+	// Show the main window after printing, without the
+	//	decorations that refresh() also redraws
+	virtual void _flush() const {
+		wrefresh(_main);
+	}
+
+	// Add text at the cursor, with control characters as spaces
+	void _add_text(std::string_view text) const {
+		size_t i = 0;
+		while (i < text.size()) {
+			size_t j = i;
+			while (j < text.size() && !DisplayWidth::control(text[j]))
+				j++;
+
+			waddnstr(_main, text.data() + i, j - i);
+			for (i = j; i < text.size() && DisplayWidth::control(text[i]); i++)
+				waddch(_main, ' ');
+		}
+	}
+
 	// TODO: do we need subwindows?
 public:
 	// Default constructor
@@ -73,10 +687,12 @@ public:
 		_main = newwin(info.height, info.width, info.y, info.x);
 	}
 
-	// Destructor
+	// Destructor, pads are not refreshed (they are cleared by
+	//	PadWindow through prefresh)
 	virtual ~PlainWindow() {
 		werase(_main);
-		wrefresh(_main);
+		if (!is_pad(_main))
+			wrefresh(_main);
 		delwin(_main);
 	}
 
@@ -109,24 +725,24 @@ public:
 	template <typename ... Args>
 	void printf(const char *str, Args ... args) const {
 		wprintw(_main, str, args...);
-		wrefresh(_main);
+		_flush();
 	}
 
 	template <typename ... Args>
 	void mvprintf(int y, int x, const char *str, Args ... args) const {
 		mvwprintw(_main, y, x, str, args...);
-		wrefresh(_main);
+		_flush();
 	}
 
 	// Adding characters
 	void add_char(const chtype ch) const {
 		waddch(_main, ch);
-		wrefresh(_main);
+		_flush();
 	}
 
 	void mvadd_char(int y, int x, const chtype ch) const {
 		mvwaddch(_main, y, x, ch);
-		wrefresh(_main);
+		_flush();
 	}
 
 	// Interact
@@ -139,6 +755,11 @@ public:
 		keypad(_main, bl);
 	}
 
+	// Milliseconds getc waits for a key, negative to block
+	void set_timeout(int ms) {
+		wtimeout(_main, ms);
+	}
+
 	void cursor(int y, int x) {
 		wmove(_main, y, x);
 	}
@@ -157,6 +778,89 @@ public:
 	}
 };
 
+// Window backed by a pad, for content larger than the
+//	screen; info describes the content, which is shown
+//	through a viewport whose origin can be moved for the
+//	cost of a single prefresh. ncurses keeps the size of a
+//	pad in shorts, so the content is clamped to max_size
+//	rows and columns
+class PadWindow : public PlainWindow {
+public:
+	static constexpr int max_size = 32767;
+protected:
+	// Viewport on the screen, and its origin in the pad
+	ScreenInfo _view;
+	int _oy = 0;
+	int _ox = 0;
+
+	// Printing goes through the viewport
+	virtual void _flush() const override {
+		refresh();
+	}
+public:
+	// Default constructor
+	PadWindow() = default;
+
+	// Constructors, the content starts as large as the viewport
+	PadWindow(int height, int width, int y, int x)
+			: PadWindow(ScreenInfo {height, width, y, x}, height, width) {}
+
+	PadWindow(const ScreenInfo &view)
+			: PadWindow(view, view.height, view.width) {}
+
+	PadWindow(const ScreenInfo &view, int height, int width)
+			: _view(view) {
+		height = std::min(height, max_size);
+		width = std::min(width, max_size);
+
+		info = ScreenInfo {height, width, view.y, view.x};
+		_main = newpad(height, width);
+	}
+
+	// Destructor
+	virtual ~PadWindow() {
+		// Clear the viewport
+		werase(_main);
+		refresh();
+	}
+
+	// Refreshing only copies the viewport to the screen
+	virtual void refresh() const override {
+		prefresh(_main, _oy, _ox, _view.y, _view.x,
+			_view.y + _view.height - 1,
+			_view.x + _view.width - 1);
+	}
+
+	// Resizing changes the size of the content
+	virtual void resize(int height, int width) const override {
+		wresize(_main, std::min(height, max_size), std::min(width, max_size));
+	}
+
+	// Move the origin of the viewport, clamped to the content
+	void set_origin(int y, int x) {
+		int height, width;
+		getmaxyx(_main, height, width);
+
+		_oy = std::max(0, std::min(y, height - _view.height));
+		_ox = std::max(0, std::min(x, width - _view.width));
+		refresh();
+	}
+
+	void shift_origin(int dy, int dx) {
+		set_origin(_oy + dy, _ox + dx);
+	}
+
+	// Origin of the viewport
+	std::pair <int, int> origin() const {
+		return std::make_pair(_oy, _ox);
+	}
+
+	// Viewport on the screen
+	const ScreenInfo &view() const {
+		return _view;
+	}
+};
+
 // Window with a boxed border
 class BoxedWindow : public PlainWindow {
 protected:
@@ -170,7 +874,8 @@ public:
 	// TODO: clean up (duplicated code)
 	BoxedWindow(int height, int width, int y, int x)
 			: PlainWindow(height, width, y, x) {
-		// Create the windows
+		// Create the windows, replacing the plain one
+		delwin(_main);
 		_box = newwin(height, width, y, x);
 		_main = newwin(height - 2, width - 2, y + 1, x + 1);
 
@@ -183,7 +888,8 @@ public:
 
 	BoxedWindow(const ScreenInfo &i)
 			: PlainWindow(i) {
-		// Create the windows
+		// Create the windows, replacing the plain one
+		delwin(_main);
 		_box = newwin(info.height, info.width, info.y, info.x);
 		_main = newwin(info.height - 2, info.width - 2, info.y + 1, info.x + 1);
 
@@ -215,7 +921,8 @@ public:
 	// Constructors
 	DecoratedWindow(const std::string &title, int height, int width, int y, int x)
 			: BoxedWindow(height, width, y, x), _title_str(title) {
-		// Create the windows
+		// Create the windows, replacing the boxed one
+		delwin(_main);
 		_main = newwin(height - 5, width - 2, y + 4, x + 1);
 		_title = newwin(3, width - 2, y + 1, x + 1);
 
@@ -287,8 +994,72 @@ protected:
 	Option		_option;
 	OptionList	_option_list;
 	int		_line = 0;
+	int		_top = 0;
 	bool		_terminate = false;
 
+	// Options, for windows whose options are not held in a list
+	virtual size_t _count() const {
+		return _option_list.size();
+	}
+
+	virtual std::string_view _text(size_t i) const {
+		return _option_list[i];
+	}
+
+	// Identifier of an option in the selection
+	virtual int _id(size_t i) const {
+		return i;
+	}
+
+	// First line of the options
+	virtual int _first_row() const {
+		return 0;
+	}
+
+	// Lines below the options, a blank line and the ok button
+	//	if multi
+	virtual int _footer_rows() const {
+		return _option.multi ? 2 : 0;
+	}
+
+	// Number of option lines
+	int _rows() const {
+		int rows = info.height - decoration_height - _first_row();
+		return std::max(rows - _footer_rows(), 1);
+	}
+
+	// Scroll so that the current option is in view
+	void _reveal() {
+		if (_line < _top)
+			_top = _line;
+		else if (_line >= _top + _rows())
+			_top = _line - _rows() + 1;
+
+		_top = std::max(_top, 0);
+	}
+
+	// Draw the options in view, and only those
+	void _draw_options(const Selection &selected) {
+		int width = std::max(info.width - 3, 0);
+		for (int r = 0; r < _rows(); r++) {
+			size_t i = _top + r;
+			int y = _first_row() + r;
+
+			wmove(_main, y, 0);
+			wclrtoeol(_main);
+			if (i >= _count())
+				continue;
+
+			// Highlight if selected or hovering
+			if (selected.count(_id(i)) || (int) i == _line)
+				wattron(_main, A_REVERSE);
+
+			std::string_view text = _text(i);
+			mvwaddnstr(_main, y, 1, text.data(), DisplayWidth::prefix(text, width));
+			wattrset(_main, A_NORMAL);
+		}
+	}
+
 	// Handle key input
 	void _handle_key(int c, Selection &selected) {
 		// Arrow keys
@@ -298,8 +1069,14 @@ protected:
 		if (c == KEY_DOWN)
 			_line++;
 
+		if (c == KEY_PPAGE)
+			_line -= _rows();
+
+		if (c == KEY_NPAGE)
+			_line += _rows();
+
 		// Allow overflow if multi
-		int size = _option_list.size();
+		int size = _count();
 		if (_option.multi)
 			_line = std::max(0, std::min(_line, size));
 		else
@@ -312,7 +1089,7 @@ protected:
 		// Enter key to select
 		if (c == 10) {
 			if (!_option.multi) {
-				selected.insert(_line);
+				selected.insert(_id(_line));
 				_terminate = true;
 			} else {
 				// Check if on the OK key
@@ -321,10 +1098,10 @@ protected:
 					return;
 				}
 
-				if (selected.find(_line) == selected.end())
-					selected.insert(_line);
+				if (selected.find(_id(_line)) == selected.end())
+					selected.insert(_id(_line));
 				else
-					selected.erase(_line);
+					selected.erase(_id(_line));
 			}
 		}
 	}
@@ -355,7 +1132,7 @@ public:
 			// Pad to the window width
 			int width = info.width - 4;
 			for (auto &str : _option_list) {
-				int len = str.length();
+				int len = DisplayWidth::columns(str);
 				int pad_left = (width - len) / 2;
 				int pad_right = width - len - pad_left;
 
@@ -379,18 +1156,13 @@ public:
 
 		// Loop
 		while (!_terminate) {
-			// Reprint all options
-			for (int i = 0; i < _option_list.size(); i++) {
-				// Hghlight if selected or hovering
-				if (selected.count(i) || i == _line)
-					attribute_on(A_REVERSE);
-				mvprintf(i, 1, "%s", _option_list[i].c_str());
-				attribute_set(A_NORMAL);
-			}
+			// Print the options in view
+			_reveal();
+			_draw_options(selected);
 
 			// Print ok button if multiselect
 			if (_option.multi)
-				_print_ok(_line == _option_list.size());
+				_print_ok(_line == (int) _count());
 
 			// Key handling
 			_handle_key(getc(), selected);
@@ -403,468 +1175,7176 @@ public:
 	}
 };
 
-// Display a table on a window
-template <class T>
-class Table : public PlainWindow {
+// Lines appended by one thread while other threads read them;
+//	text is kept in chunks and line spans in blocks which never
+//	move, so readers need no lock, only the published size
+class LineArena {
 public:
-	// Aliases
-	using Headers = std::vector <std::string>;
-	using Data = std::vector <T>;
-	using Generator = std::function <std::string (const T &, size_t)>;
-	using Lengths = std::vector <size_t>;
+	// Bytes of text per chunk, and lines per block
+	static constexpr size_t chunk_size = 1 << 20;
+	static constexpr size_t block_lines = 1 << 16;
+	static constexpr size_t max_blocks = 1 << 16;
 
-	// Update structure
-	struct From {
-		Headers		headers;
-		Data		data;
-		Generator	generator;
-		Lengths		lengths;
+	LineArena() : _blocks(new Line *[max_blocks]()) {}
 
-		bool		auto_resize = false;
+	LineArena(const LineArena &) = delete;
+	LineArena &operator=(const LineArena &) = delete;
 
-		// Constructor from headers and generator
-		From(const Headers &headers, Generator generator)
-				: headers(headers), generator(generator) {}
-	};
-protected:
-	Headers _headers;
-	Data _data;
-	Lengths _lengths;
+	~LineArena() {
+		for (size_t b = 0; b < max_blocks && _blocks[b]; b++)
+			delete[] _blocks[b];
+	}
 
-	// TODO: array of lengths for each column (either auto or specified)
+	// Append a line, only from the writing thread; false if full
+	bool append(std::string_view line) {
+		size_t n = _count;
+		if (n == max_blocks * block_lines)
+			return false;
+
+		// Long lines get a chunk of their own
+		if (line.size() > _left) {
+			size_t size = std::max(chunk_size, line.size());
+			_chunks.emplace_back(new char[size]);
+			_next = _chunks.back().get();
+			_left = size;
+		}
 
-	// Function to generate columns from data
-	Generator _generator;
+		std::memcpy(_next, line.data(), line.size());
 
-	// Get lengths for each column
-	void _get_lengths() {
-		_lengths = Lengths(_headers.size(), 0);
+		Line *&block = _blocks[n / block_lines];
+		if (!block)
+			block = new Line[block_lines];
 
-		for (size_t i = 0; i < _headers.size(); i++) {
-			_lengths[i] = _headers[i].length();
-			for (const auto &d : _data) {
-				size_t l = _generator(d, i).length();
-				if (l > _lengths[i])
-					_lengths[i] = l;
-			}
-		}
+		block[n % block_lines] = Line {_next, line.size()};
+		_next += line.size();
+		_left -= line.size();
+
+		_count = n + 1;
+		_size.store(_count, std::memory_order_release);
+		return true;
 	}
 
-	// Write table
-	void _write_table(int highlight = -1) const {
-		// Variables
-		int x = 0;
-		int line = 0;
+	// Number of lines readable from any thread
+	size_t size() const {
+		return _size.load(std::memory_order_acquire);
+	}
 
-		// Write top bar
-		x = 0;
+	std::string_view operator[](size_t i) const {
+		const Line &line = _blocks[i / block_lines][i % block_lines];
+		return std::string_view(line.text, line.length);
+	}
+protected:
+	struct Line {
+		const char *text;
+		size_t length;
+	};
 
-		mvadd_char(line, 0, ACS_ULCORNER);
-		for (size_t i = 0; i < _headers.size(); i++) {
-			for (int j = 0; j < _lengths[i] + 2; j++)
-				mvadd_char(line, x + j + 1, ACS_HLINE);
-			x += _lengths[i] + 3;
+	std::unique_ptr <Line *[]> _blocks;
+	std::atomic <size_t> _size {0};
 
-			if (i != _headers.size() - 1)
-				mvadd_char(line, x, ACS_TTEE);
-			else
-				mvadd_char(line, x, ACS_URCORNER);
-		}
-		line++;
+	// Writer state
+	std::vector <std::unique_ptr <char[]>> _chunks;
+	char *_next = nullptr;
+	size_t _left = 0;
+	size_t _count = 0;
+};
 
-		// Write headers
-		x = 1;
-		for (size_t i = 0; i < _headers.size(); i++) {
-			mvprintf(line, x, " %s ", _headers[i].c_str());
-			x += _lengths[i] + 3;
-			mvadd_char(line, x - 1, ACS_VLINE);
-		}
-		mvadd_char(line, 0, ACS_VLINE);
-		line++;
+// Fuzzy matching in the manner of fzf: every space separated term
+//	of the pattern must appear in the text as a subsequence, found
+//	forward and then tightened backward from its end; matches score
+//	for consecutive characters and characters starting words, and
+//	lose for gaps. Patterns without uppercase ignore case
+class FuzzyMatch {
+public:
+	static constexpr int no_match = -(1 << 30);
 
-		// Write middle bar
-		x = 0;
+	FuzzyMatch() = default;
 
-		mvadd_char(line, 0, ACS_LTEE);
-		for (size_t i = 0; i < _headers.size(); i++) {
-			for (int j = 0; j < _lengths[i] + 2; j++)
-				mvadd_char(line, x + j + 1, ACS_HLINE);
-			x += _lengths[i] + 3;
+	FuzzyMatch(std::string_view pattern) {
+		_ignore_case = std::none_of(pattern.begin(), pattern.end(),
+			[](char c) { return std::isupper((unsigned char) c); });
 
-			if (i != _headers.size() - 1)
-				mvadd_char(line, x, ACS_PLUS);
-			else
-				mvadd_char(line, x, ACS_RTEE);
-		}
-		line++;
+		size_t i = 0;
+		while (i < pattern.size()) {
+			size_t end = pattern.find(' ', i);
+			if (end == std::string_view::npos)
+				end = pattern.size();
 
-		// Write data
-		for (size_t n = 0; n < _data.size(); n++) {
-			x = 1;
+			if (end > i)
+				_terms.emplace_back(pattern.substr(i, end - i));
 
-			T d = _data[n];
-			for (size_t i = 0; i < _headers.size(); i++) {
-				std::string str = _generator(d, i);
+			i = end + 1;
+		}
+	}
+
+	bool empty() const {
+		return _terms.empty();
+	}
+
+	// Score of a text, no_match if some term is missing
+	int score(std::string_view text) const {
+		int total = 0;
+		for (const auto &term : _terms) {
+			int s = _score(text, term);
+			if (s == no_match)
+				return no_match;
+
+			total += s;
+		}
+
+		return total;
+	}
+protected:
+	std::vector <std::string> _terms;
+	bool _ignore_case = true;
+
+	bool _equal(char t, char p) const {
+		return _ignore_case ? std::tolower((unsigned char) t) == p : t == p;
+	}
+
+	int _score(std::string_view text, std::string_view term) const {
+		// Forward, to the end of the first match
+		size_t p = 0;
+		size_t end = 0;
+		for (size_t i = 0; i < text.size(); i++) {
+			if (_equal(text[i], term[p]) && ++p == term.size()) {
+				end = i + 1;
+				break;
+			}
+		}
+
+		if (p < term.size())
+			return no_match;
+
+		// Backward, to the start of the shortest match ending there
+		size_t start = end;
+		while (p > 0) {
+			start--;
+			if (_equal(text[start], term[p - 1]))
+				p--;
+		}
+
+		// Score the characters in [start, end)
+		int score = 0;
+		bool consecutive = false;
+		for (size_t i = start; i < end && p < term.size(); i++) {
+			unsigned char c = text[i];
+			if (!_equal(c, term[p])) {
+				score -= consecutive ? 3 : 1;
+				consecutive = false;
+				continue;
+			}
+
+			score += 16;
+			if (consecutive)
+				score += 8;
+
+			unsigned char before = (i > 0) ? text[i - 1] : ' ';
+			if (!std::isalnum(before))
+				score += 10;
+			else if (std::isupper(c) && std::islower(before))
+				score += 8;
+
+			consecutive = true;
+			p++;
+		}
+
+		return score;
+	}
+};
+
+// Picker for lines streamed from a file descriptor (such as stdin),
+//	read in the background into a LineArena while the window is in
+//	use; typing filters the lines with FuzzyMatch on a background
+//	pass split among threads, which the next keystroke cancels.
+//	Extending the query only filters the previous matches, and new
+//	lines are matched as they arrive
+class Picker : public SelectionWindow {
+public:
+	// Matching line and its score
+	struct Match {
+		size_t line;
+		int score;
+	};
+
+	// Lines matched per thread between checks for cancellation
+	static constexpr size_t match_chunk = 4096;
+
+	// Milliseconds between redraws while lines stream in
+	static constexpr int poll_ms = 30;
+
+	// Constructor
+	Picker(const std::string &title, const ScreenInfo &info, bool multi = false)
+			: SelectionWindow(title, info, {}, Option {false, multi}) {}
+
+	// Destructor
+	~Picker() {
+		_cancel();
+
+		_stop = true;
+		if (_reader.joinable())
+			_reader.join();
+	}
+
+	// Read lines from a file descriptor in the background, until
+	//	its end; the descriptor is not closed
+	void read(int fd) {
+		_reader = std::thread(&Picker::_read, this, fd);
+	}
+
+	// Add a line from the calling thread, if no reader is running
+	void push(std::string_view line) {
+		_lines.append(line);
+	}
+
+	void set_query(const std::string &query) {
+		_query = query;
+	}
+
+	// Number of lines read so far, and whether all were read
+	size_t lines() const {
+		return _lines.size();
+	}
+
+	bool complete() const {
+		return _eof;
+	}
+
+	// Let the user pick; Enter appends the marked lines (or the
+	//	current one) to chosen, escape cancels and returns false
+	bool yield(std::vector <std::string> &chosen) {
+		Selection marked;
+
+		noecho();
+		curs_set(0);
+		keypad(_main, true);
+		wtimeout(_main, poll_ms);
+
+		bool accepted = false;
+		while (!_terminate) {
+			_update_matches();
+
+			// Keep the cursor on an option
+			int size = _count();
+			_line = std::max(0, std::min(_line, size - 1));
+			_reveal();
+
+			_draw_prompt();
+			_draw_options(marked);
+			refresh();
+
+			int c = getc();
+			switch (c) {
+			case ERR:
+				break;
+			case KEY_UP:
+			case 16: // Ctrl-P
+				_line--;
+				break;
+			case KEY_DOWN:
+			case 14: // Ctrl-N
+				_line++;
+				break;
+			case KEY_PPAGE:
+				_line -= _rows();
+				break;
+			case KEY_NPAGE:
+				_line += _rows();
+				break;
+			case '\t':
+				// Mark, if multi
+				if (_option.multi && _line < size) {
+					int id = _id(_line);
+					if (!marked.erase(id))
+						marked.insert(id);
+
+					_line++;
+				}
+				break;
+			case 10:
+				// Choose from the matches of the query as typed
+				_settle();
+				size = _count();
+				_line = std::max(0, std::min(_line, size - 1));
+
+				if (marked.empty() && _line < size)
+					marked.insert(_id(_line));
+
+				for (int id : marked)
+					chosen.emplace_back(_lines[id]);
+
+				accepted = true;
+				_terminate = true;
+				break;
+			case 27: // Escape key
+				_terminate = true;
+				break;
+			case KEY_BACKSPACE:
+			case 127:
+			case 8:
+				if (!_query.empty())
+					_query.pop_back();
+				break;
+			case 21: // Ctrl-U
+				_query.clear();
+				break;
+			default:
+				if (c >= 0 && c < 256 && std::isprint(c))
+					_query += c;
+				break;
+			}
+		}
+
+		wtimeout(_main, -1);
+		_cancel();
+		return accepted;
+	}
+protected:
+	LineArena _lines;
+
+	// Reader
+	std::thread _reader;
+	std::atomic <bool> _eof {false};
+	std::atomic <bool> _stop {false};
+
+	std::string _query;
+
+	// Results of the latest pass, for a query over the first lines
+	std::vector <Match> _matches;
+	std::string _matched_query;
+	size_t _matched_lines = 0;
+
+	// Running pass, and its results
+	std::thread _pass;
+	std::atomic <bool> _cancelled {false};
+	std::atomic <bool> _finished {false};
+	std::vector <Match> _result;
+	std::string _pass_query;
+	size_t _pass_lines = 0;
+
+	size_t _count() const override {
+		return _query.empty() ? _lines.size() : _matches.size();
+	}
+
+	std::string_view _text(size_t i) const override {
+		return _lines[_id(i)];
+	}
+
+	int _id(size_t i) const override {
+		return _query.empty() ? i : _matches[i].line;
+	}
+
+	// The query takes the first line, and Enter accepts the
+	//	marks, so there is no ok button
+	int _first_row() const override {
+		return 1;
+	}
+
+	int _footer_rows() const override {
+		return 0;
+	}
+
+	void _draw_prompt() {
+		wmove(_main, 0, 0);
+		wclrtoeol(_main);
+
+		int width = std::max(info.width - 2, 0);
+
+		char status[64];
+		bool busy = !_eof || (!_query.empty() && _matched_query != _query);
+		int n = std::snprintf(status, sizeof(status), "%s%zu/%zu",
+			busy ? ".. " : "", _count(), _lines.size());
+
+		mvwaddnstr(_main, 0, 0, "> ", width);
+		waddnstr(_main, _query.c_str(), std::max(width - n - 3, 0));
+		if (width > n)
+			mvwaddstr(_main, 0, width - n, status);
+	}
+
+	// Stop the running pass, dropping its results
+	void _cancel() {
+		if (!_pass.joinable())
+			return;
+
+		_cancelled = true;
+		_pass.join();
+		_cancelled = false;
+		_finished = false;
+	}
+
+	// Wait for the matches of the query over the lines read so far
+	void _settle() {
+		for (int i = 0; i < 2 && _pass.joinable(); i++) {
+			_pass.join();
+			_update_matches();
+		}
+	}
+
+	// Adopt finished passes and start the next one if needed
+	void _update_matches() {
+		if (_finished) {
+			if (_pass.joinable())
+				_pass.join();
+
+			_finished = false;
+
+			_matches.swap(_result);
+			_matched_query = _pass_query;
+			_matched_lines = _pass_lines;
+			_result.clear();
+		}
+
+		if (_query.empty()) {
+			_cancel();
+			_matched_query.clear();
+			_matches.clear();
+			_matched_lines = 0;
+			return;
+		}
+
+		// A pass for another query is stale
+		if (_pass.joinable()) {
+			if (_pass_query == _query)
+				return;
+
+			_cancel();
+		}
+
+		size_t lines = _lines.size();
+		if (_matched_query == _query && _matched_lines == lines)
+			return;
+
+		// The matches of a prefix of the query hold all the
+		//	matches of the query among their lines
+		bool narrow = !_matched_query.empty()
+			&& _query.compare(0, _matched_query.size(), _matched_query) == 0;
+
+		std::vector <Match> base;
+		if (narrow)
+			base = _matches;
+
+		_pass_query = _query;
+		_pass_lines = lines;
+		_pass = std::thread(&Picker::_match, this, std::move(base),
+			narrow ? _matched_lines : 0, lines, _query,
+			_matched_query == _query);
+	}
+
+	// Match candidates (the previous matches, then lines [from, to))
+	//	in parallel; if keep, the candidates already match and are
+	//	kept as they are
+	void _match(std::vector <Match> base, size_t from, size_t to,
+			std::string query, bool keep) {
+		FuzzyMatch pattern(query);
+
+		size_t total = (keep ? 0 : base.size()) + (to - from);
+		auto candidate = [&](size_t k) {
+			return (!keep && k < base.size()) ? base[k].line
+				: from + (k - (keep ? 0 : base.size()));
+		};
+
+		size_t workers = std::max(1u, std::thread::hardware_concurrency());
+		size_t chunks = std::min(workers, total / match_chunk + 1);
+		size_t per_chunk = (total + chunks - 1) / chunks;
+
+		std::vector <std::vector <Match>> parts(chunks);
+		auto work = [&](size_t c) {
+			size_t end = std::min(total, (c + 1) * per_chunk);
+			for (size_t k = c * per_chunk; k < end; k++) {
+				if ((k % match_chunk) == 0 && _cancelled)
+					return;
+
+				size_t line = candidate(k);
+				int score = pattern.score(_lines[line]);
+				if (score != FuzzyMatch::no_match)
+					parts[c].push_back(Match {line, score});
+			}
+		};
+
+		std::vector <std::thread> threads;
+		for (size_t c = 1; c < chunks; c++)
+			threads.emplace_back(work, c);
+
+		work(0);
+		for (auto &thread : threads)
+			thread.join();
+
+		if (_cancelled)
+			return;
+
+		// Best first, then in reading order
+		auto better = [](const Match &a, const Match &b) {
+			return (a.score != b.score) ? a.score > b.score : a.line < b.line;
+		};
+
+		std::vector <Match> result = keep ? std::move(base) : std::vector <Match> ();
+		size_t sorted = result.size();
+		for (const auto &part : parts)
+			result.insert(result.end(), part.begin(), part.end());
+
+		std::sort(result.begin() + sorted, result.end(), better);
+		std::inplace_merge(result.begin(), result.begin() + sorted,
+			result.end(), better);
+
+		_result = std::move(result);
+		_finished = true;
+	}
+
+	// Read lines until the end of the file or until stopped
+	void _read(int fd) {
+		std::string partial;
+		char buffer[1 << 16];
+
+		pollfd pfd {fd, POLLIN, 0};
+		while (!_stop) {
+			if (::poll(&pfd, 1, 100) <= 0)
+				continue;
+
+			ssize_t n = ::read(fd, buffer, sizeof(buffer));
+			if (n <= 0)
+				break;
+
+			// Whole lines straight from the buffer, the rest is
+			//	kept for the next read
+			size_t start = 0;
+			for (size_t i = 0; i < (size_t) n; i++) {
+				if (buffer[i] != '\n')
+					continue;
+
+				if (partial.empty()) {
+					_lines.append(std::string_view(buffer + start, i - start));
+				} else {
+					partial.append(buffer + start, i - start);
+					_lines.append(partial);
+					partial.clear();
+				}
+
+				start = i + 1;
+			}
+
+			partial.append(buffer + start, n - start);
+		}
+
+		if (!partial.empty())
+			_lines.append(partial);
+
+		_eof = true;
+	}
+};
+
+// Numeric column formatter, built on std::to_chars so that
+//	no locale is consulted and nothing is allocated until
+//	the final (usually short, inline) string
+struct NumberFormat {
+	// Humanized suffixes: powers of 1000 (k, M, G, ...)
+	//	or powers of 1024 (Ki, Mi, Gi, ...)
+	enum class Suffix {
+		NONE,
+		SI,
+		IEC
+	};
+
+	int	precision = 2;
+	Suffix	suffix = Suffix::NONE;
+	bool	separators = false;
+	bool	right = true;
+	size_t	width = 0;
+
+	// Size of the buffers passed to write
+	static constexpr size_t buffer_size = 64;
+
+	// Largest precision used, so that any value fits the buffer
+	static constexpr int max_precision = 20;
+
+	// Write a floating point value into buf, returns the length
+	size_t write(double value, char *buf) const {
+		int digits = std::clamp(precision, 0, max_precision);
+		const char *unit = _scale(value, digits);
+
+		// Fixed notation, unless it does not fit comfortably
+		char tmp[buffer_size] = {};
+		auto res = std::to_chars(tmp, tmp + 32, value,
+			std::chars_format::fixed, digits);
+		if (res.ec != std::errc())
+			res = std::to_chars(tmp, tmp + buffer_size, value,
+				std::chars_format::scientific, digits);
+
+		// Placeholder for values that cannot be written
+		if (res.ec != std::errc())
+			return _compose("#", 1, "", buf);
+
+		return _compose(tmp, res.ptr - tmp, unit, buf);
+	}
+
+	// Write an integral value into buf, returns the length
+	template <class I, class = std::enable_if_t <std::is_integral_v <I>>>
+	size_t write(I value, char *buf) const {
+		// Suffixes need a fractional part
+		if (suffix != Suffix::NONE)
+			return write(static_cast <double> (value), buf);
+
+		char tmp[buffer_size] = {};
+		auto res = std::to_chars(tmp, tmp + buffer_size, value);
+		return _compose(tmp, res.ptr - tmp, "", buf);
+	}
+
+	// Format a value as a string
+	template <class N>
+	std::string operator()(N value) const {
+		char buf[buffer_size];
+		return std::string(buf, write(value, buf));
+	}
+protected:
+	// Scale a value down by the suffix base, returns the unit
+	const char *_scale(double &value, int digits) const {
+		static const char *si[] = {"", "k", "M", "G", "T", "P", "E"};
+		static const char *iec[] = {"", "Ki", "Mi", "Gi", "Ti", "Pi", "Ei"};
+
+		if (suffix == Suffix::NONE || !std::isfinite(value))
+			return "";
+
+		double base = (suffix == Suffix::SI) ? 1000.0 : 1024.0;
+		const char **units = (suffix == Suffix::SI) ? si : iec;
+
+		// Values which round up to the base (999.999 to two
+		//	digits) take the next unit
+		double scale = std::pow(10.0, digits);
+		auto reaches = [&]() {
+			return std::round(std::fabs(value) * scale) >= base * scale;
+		};
+
+		size_t i = 0;
+		while (reaches() && i < 6) {
+			value /= base;
+			i++;
+		}
+
+		return units[i];
+	}
+
+	// Insert separators, append the unit and pad to the width,
+	//	writing at most buffer_size - 1 characters
+	size_t _compose(const char *tmp, size_t len, const char *unit, char *buf) const {
+		char *out = buf;
+		char *end = buf + buffer_size - 1;
+		auto put = [&](char c) {
+			if (out < end)
+				*out++ = c;
+		};
+
+		// Sign and integer digits
+		size_t i = 0;
+		if (i < len && tmp[i] == '-')
+			put(tmp[i++]);
+
+		size_t digits = 0;
+		while (i + digits < len && tmp[i + digits] >= '0' && tmp[i + digits] <= '9')
+			digits++;
+
+		for (size_t j = 0; j < digits; j++) {
+			if (separators && j > 0 && (digits - j) % 3 == 0)
+				put(',');
+			put(tmp[i + j]);
+		}
+
+		// Fraction (or exponent) and unit
+		for (i += digits; i < len; i++)
+			put(tmp[i]);
+
+		for (; *unit; unit++)
+			put(*unit);
+
+		// Pad to the width
+		size_t n = out - buf;
+		size_t w = std::min(width, buffer_size - 1);
+		if (n >= w)
+			return n;
+
+		if (right) {
+			std::memmove(buf + (w - n), buf, n);
+			std::memset(buf, ' ', w - n);
+		} else {
+			std::memset(buf + n, ' ', w - n);
+		}
+
+		return w;
+	}
+};
+
+// Substring search over the text of a set of rows; the text
+//	is copied into one contiguous buffer (built once, on the
+//	first search, and resumed by the next if cut short) and
+//	scanned on a background thread, with the matching rows
+//	delivered incrementally and in order
+class TextSearch {
+public:
+	// Append the text of a row to the buffer
+	using Producer = std::function <void (size_t, std::string &)>;
+
+	// Rows handled between deliveries of matches
+	static constexpr size_t chunk = 4096;
+
+	// Default constructor
+	TextSearch() = default;
+
+	// Not copyable (owns a thread)
+	TextSearch(const TextSearch &) = delete;
+	TextSearch &operator=(const TextSearch &) = delete;
+
+	// Destructor
+	~TextSearch() {
+		cancel();
+	}
+
+	// Discard the buffer and its producer, the next search
+	//	rebuilds it
+	void invalidate() {
+		cancel();
+
+		_built = false;
+		_text.clear();
+		_offsets.clear();
+		_producer = nullptr;
+	}
+
+	// Check if the buffer is built
+	bool built() const {
+		return _built;
+	}
+
+	// Check if there is a producer for the rest of the buffer
+	bool producing() const {
+		return _built || _producer;
+	}
+
+	// Rows in the buffer so far, while no search is running
+	size_t produced() const {
+		return _offsets.size();
+	}
+
+	// Start searching for a query; the producer is kept until
+	//	the buffer is built (or invalidated), and only needs to
+	//	be given if there is none yet
+	void start(const std::string &query, size_t rows, const Producer &producer = nullptr) {
+		cancel();
+
+		if (producer)
+			_producer = producer;
+
+		_pending.clear();
+		_running = true;
+		_thread = std::thread(&TextSearch::_run, this, query, rows);
+	}
+
+	// Stop searching
+	void cancel() {
+		_cancel = true;
+		if (_thread.joinable())
+			_thread.join();
+
+		_cancel = false;
+		_running = false;
+
+		// The rows are no longer needed once in the buffer
+		if (_built)
+			_producer = nullptr;
+	}
+
+	// Check if the search is still running
+	bool running() const {
+		return _running;
+	}
+
+	// Append the rows matched since the last call, returns
+	//	the number of rows appended
+	size_t collect(std::vector <size_t> &rows) {
+		std::lock_guard <std::mutex> guard(_lock);
+
+		size_t count = _pending.size();
+		rows.insert(rows.end(), _pending.begin(), _pending.end());
+		_pending.clear();
+		return count;
+	}
+
+	// Find the first occurence of a needle in [begin, end);
+	//	candidates are found with memchr on the needle's first
+	//	byte, which libc vectorizes
+	static const char *find(const char *begin, const char *end, const std::string &needle) {
+		size_t n = needle.size();
+		if (n == 0 || (size_t) (end - begin) < n)
+			return nullptr;
+
+		const char *last = end - n;
+		for (const char *p = begin; p <= last; p++) {
+			p = (const char *) std::memchr(p, needle[0], last - p + 1);
+			if (!p)
+				return nullptr;
+
+			if (p[n - 1] == needle[n - 1]
+					&& std::memcmp(p, needle.data(), n) == 0)
+				return p;
+		}
+
+		return nullptr;
+	}
+protected:
+	// Row texts, separated by newlines, and the offset of
+	//	each row in the buffer
+	std::string		_text;
+	std::vector <size_t>	_offsets;
+	std::atomic <bool>	_built {false};
+	Producer		_producer;
+
+	// Thread state
+	std::thread		_thread;
+	std::atomic <bool>	_cancel {false};
+	std::atomic <bool>	_running {false};
+
+	// Matches not yet collected
+	std::mutex		_lock;
+	std::vector <size_t>	_pending;
+
+	// Search thread
+	void _run(std::string query, size_t rows) {
+		std::vector <size_t> found;
+
+		size_t start = 0;
+		while (start < rows && !_cancel) {
+			size_t end = std::min(start + chunk, rows);
+
+			// Extend the buffer past the rows built so far
+			for (size_t n = _offsets.size(); n < end; n++) {
+				_offsets.push_back(_text.size());
+				_producer(n, _text);
+				_text.push_back('\n');
+			}
+
+			// Scan the chunk, one match per row
+			const char *base = _text.data();
+			const char *limit = base
+				+ (end < _offsets.size() ? _offsets[end] : _text.size());
+
+			const char *p = base + _offsets[start];
+			while ((p = find(p, limit, query))) {
+				size_t offset = p - base;
+				auto it = std::upper_bound(_offsets.begin() + start,
+					_offsets.begin() + end, offset);
+
+				size_t row = (it - _offsets.begin()) - 1;
+				found.push_back(row);
+
+				if (row + 1 >= end)
+					break;
+
+				p = base + _offsets[row + 1];
+			}
+
+			// Deliver
+			if (!found.empty()) {
+				std::lock_guard <std::mutex> guard(_lock);
+				_pending.insert(_pending.end(), found.begin(), found.end());
+				found.clear();
+			}
+
+			start = end;
+		}
+
+		if (start >= rows && _offsets.size() == rows)
+			_built = true;
+
+		_running = false;
+	}
+};
+
+// Row filter expression, compiled to a flat postfix program
+//	over the columns of a table, for example
+//
+//	cpu > 80 && (name ~ "db" || !(state == "idle"))
+//
+// Columns are referred to by header (case insensitive, if it
+//	is an identifier) or by index ($0, $1, ...). Comparisons
+//	are between a column and a literal: numbers compare the
+//	column's numeric value, strings its text, and ~ (!~)
+//	checks if the text contains (does not contain) a string.
+class Filter {
+public:
+	enum class Op : uint8_t {
+		EQ,
+		NE,
+		LT,
+		LE,
+		GT,
+		GE,
+		HAS,
+		NOT_HAS,
+		AND,
+		OR,
+		NOT
+	};
+
+	// Single instruction, comparisons push one result on
+	//	the stack and logical operators pop theirs
+	struct Instruction {
+		Op		op;
+		bool		text;
+		uint32_t	column;
+		uint32_t	string;
+		double		number;
+	};
+
+	// Maximum nesting of the expression
+	static constexpr int max_depth = 64;
+
+	// Compile an expression, returns false (and sets error)
+	//	if it is invalid, keeping the previous program; an
+	//	empty expression matches all rows
+	bool compile(const std::string &expr, const std::vector <std::string> &headers,
+			std::string &error) {
+		Filter next;
+		if (!next._compile(expr, headers, error))
+			return false;
+
+		*this = std::move(next);
+		_headers = nullptr;
+		return true;
+	}
+
+	// Check if the filter matches every row
+	bool empty() const {
+		return _code.empty();
+	}
+
+	// Columns referred to by the expression
+	const std::vector <size_t> &columns() const {
+		return _columns;
+	}
+
+	// Evaluate the filter for a row, given functions for the
+	//	text (std::string (size_t)) and numeric value
+	//	(double (size_t)) of its columns
+	template <class Text, class Number>
+	bool match(Text text, Number number) const {
+		uint64_t stack = 0;
+		for (const auto &ins : _code) {
+			bool r;
+			switch (ins.op) {
+			case Op::AND:
+				r = (stack & 1) && (stack & 2);
+				stack >>= 2;
+				break;
+			case Op::OR:
+				r = (stack & 3);
+				stack >>= 2;
+				break;
+			case Op::NOT:
+				r = !(stack & 1);
+				stack >>= 1;
+				break;
+			default:
+				r = ins.text ? _compare(ins, text(ins.column))
+					: _compare(ins, number(ins.column));
+				break;
+			}
+
+			stack = (stack << 1) | r;
+		}
+
+		return _code.empty() || (stack & 1);
+	}
+protected:
+	std::vector <Instruction>	_code;
+	std::vector <std::string>	_strings;
+	std::vector <size_t>		_columns;
+
+	// Parser state
+	std::string			_src;
+	size_t				_pos = 0;
+	const std::vector <std::string>	*_headers = nullptr;
+	std::string			_error;
+	int				_nesting = 0;
+
+	// Parse an expression into a new filter
+	bool _compile(const std::string &expr, const std::vector <std::string> &headers,
+			std::string &error) {
+		_src = expr;
+		_pos = 0;
+		_headers = &headers;
+		_error.clear();
+
+		_skip();
+		if (_pos < _src.size()) {
+			_or();
+			_skip();
+			if (_error.empty() && _pos < _src.size())
+				_fail("unexpected input");
+		}
+
+		// Check the depth of the stack
+		int depth = 0;
+		for (const auto &ins : _code) {
+			depth += (ins.op == Op::AND || ins.op == Op::OR) ? -1
+				: (ins.op == Op::NOT) ? 0 : 1;
+			if (depth > max_depth)
+				_fail("expression is too deeply nested");
+		}
+
+		error = _error;
+		return _error.empty();
+	}
+
+	bool _compare(const Instruction &ins, const std::string &value) const {
+		const std::string &literal = _strings[ins.string];
+		switch (ins.op) {
+		case Op::EQ:
+			return value == literal;
+		case Op::NE:
+			return value != literal;
+		case Op::HAS:
+			return value.find(literal) != std::string::npos;
+		case Op::NOT_HAS:
+			return value.find(literal) == std::string::npos;
+		default:
+			break;
+		}
+
+		return false;
+	}
+
+	bool _compare(const Instruction &ins, double value) const {
+		switch (ins.op) {
+		case Op::EQ:
+			return value == ins.number;
+		case Op::NE:
+			return value != ins.number;
+		case Op::LT:
+			return value < ins.number;
+		case Op::LE:
+			return value <= ins.number;
+		case Op::GT:
+			return value > ins.number;
+		case Op::GE:
+			return value >= ins.number;
+		default:
+			break;
+		}
+
+		return false;
+	}
+
+	void _fail(const std::string &msg) {
+		if (_error.empty())
+			_error = msg + " at column " + std::to_string(_pos + 1);
+
+		_pos = _src.size();
+	}
+
+	void _skip() {
+		while (_pos < _src.size() && std::isspace((unsigned char) _src[_pos]))
+			_pos++;
+	}
+
+	bool _accept(const char *token) {
+		_skip();
+
+		size_t n = std::strlen(token);
+		if (_src.compare(_pos, n, token) != 0)
+			return false;
+
+		_pos += n;
+		return true;
+	}
+
+	void _emit(Op op) {
+		_code.push_back(Instruction {op, false, 0, 0, 0});
+	}
+
+	// or := and ('||' and)*
+	void _or() {
+		_and();
+		while (_error.empty() && _accept("||")) {
+			_and();
+			_emit(Op::OR);
+		}
+	}
+
+	// and := unary ('&&' unary)*
+	void _and() {
+		_unary();
+		while (_error.empty() && _accept("&&")) {
+			_unary();
+			_emit(Op::AND);
+		}
+	}
+
+	// unary := '!' unary | '(' or ')' | comparison
+	void _unary() {
+		if (_accept("!")) {
+			if (!_nest())
+				return;
+
+			_unary();
+			_emit(Op::NOT);
+			_nesting--;
+		} else if (_accept("(")) {
+			if (!_nest())
+				return;
+
+			_or();
+			if (!_accept(")"))
+				_fail("expected ')'");
+			_nesting--;
+		} else {
+			_comparison();
+		}
+	}
+
+	// Enter a nested expression, failing past the maximum depth
+	//	before the parser recurses any deeper
+	bool _nest() {
+		if (++_nesting > max_depth) {
+			_fail("expression is too deeply nested");
+			return false;
+		}
+
+		return true;
+	}
+
+	// Parse a column reference, returns false if there is none
+	bool _column(uint32_t &column) {
+		_skip();
+
+		size_t start = _pos;
+		if (_pos < _src.size() && _src[_pos] == '$') {
+			_pos++;
+			size_t index = 0;
+			auto res = std::from_chars(_src.data() + _pos,
+				_src.data() + _src.size(), index);
+			if (res.ec != std::errc() || index >= _headers->size()) {
+				_pos = start;
+				_fail("invalid column index");
+				return false;
+			}
+
+			_pos = res.ptr - _src.data();
+			column = index;
+		} else {
+			while (_pos < _src.size() && (std::isalnum((unsigned char) _src[_pos])
+					|| _src[_pos] == '_'))
+				_pos++;
+
+			if (_pos == start || std::isdigit((unsigned char) _src[start])) {
+				_pos = start;
+				return false;
+			}
+
+			std::string name = _src.substr(start, _pos - start);
+
+			size_t i = 0;
+			for (; i < _headers->size(); i++) {
+				const std::string &h = (*_headers)[i];
+				if (h.size() == name.size() && std::equal(h.begin(), h.end(), name.begin(),
+						[](char a, char b) {
+							return std::tolower((unsigned char) a)
+								== std::tolower((unsigned char) b);
+						}))
+					break;
+			}
+
+			if (i == _headers->size()) {
+				_pos = start;
+				_fail("unknown column '" + name + "'");
+				return false;
+			}
+
+			column = i;
+		}
+
+		if (std::find(_columns.begin(), _columns.end(), column) == _columns.end())
+			_columns.push_back(column);
+
+		return true;
+	}
+
+	// Parse a literal into ins, returns false if there is none
+	bool _literal(Instruction &ins) {
+		_skip();
+		if (_pos >= _src.size())
+			return false;
+
+		// Quoted string, with backslash escapes
+		if (_src[_pos] == '"') {
+			std::string str;
+			for (_pos++; _pos < _src.size() && _src[_pos] != '"'; _pos++) {
+				if (_src[_pos] == '\\' && _pos + 1 < _src.size())
+					_pos++;
+				str += _src[_pos];
+			}
+
+			if (_pos >= _src.size()) {
+				_fail("unterminated string");
+				return false;
+			}
+
+			_pos++;
+			ins.text = true;
+			ins.string = _strings.size();
+			_strings.push_back(str);
+			return true;
+		}
+
+		// Number
+		const char *begin = _src.data() + _pos;
+		const char *end = _src.data() + _src.size();
+		if (*begin == '+')
+			begin++;
+
+		auto res = std::from_chars(begin, end, ins.number);
+		if (res.ec != std::errc())
+			return false;
+
+		_pos = res.ptr - _src.data();
+		ins.text = false;
+		return true;
+	}
+
+	// comparison := column op literal | literal op column
+	void _comparison() {
+		Instruction ins {Op::EQ, false, 0, 0, 0};
+
+		bool flipped = false;
+		if (!_column(ins.column)) {
+			if (!_error.empty())
+				return;
+
+			if (!_literal(ins)) {
+				_fail("expected a column or literal");
+				return;
+			}
+
+			flipped = true;
+		}
+
+		// Operator (longest first)
+		static const std::pair <const char *, Op> ops[] = {
+			{"==", Op::EQ}, {"!=", Op::NE}, {"<=", Op::LE},
+			{">=", Op::GE}, {"!~", Op::NOT_HAS}, {"<", Op::LT},
+			{">", Op::GT}, {"~", Op::HAS}, {"=", Op::EQ}
+		};
+
+		bool found = false;
+		for (const auto &op : ops) {
+			if (_accept(op.first)) {
+				ins.op = op.second;
+				found = true;
+				break;
+			}
+		}
+
+		if (!found) {
+			_fail("expected a comparison operator");
+			return;
+		}
+
+		if (flipped ? !_column(ins.column) : !_literal(ins)) {
+			_fail(flipped ? "expected a column" : "expected a literal");
+			return;
+		}
+
+		// Normalize to column op literal
+		if (flipped) {
+			switch (ins.op) {
+			case Op::LT: ins.op = Op::GT; break;
+			case Op::LE: ins.op = Op::GE; break;
+			case Op::GT: ins.op = Op::LT; break;
+			case Op::GE: ins.op = Op::LE; break;
+			default: break;
+			}
+		}
+
+		// Strings are compared for (in)equality or containment,
+		//	numbers are not checked for containment
+		bool has = (ins.op == Op::HAS || ins.op == Op::NOT_HAS);
+		if (ins.text && !has && ins.op != Op::EQ && ins.op != Op::NE) {
+			_fail("strings can only be compared with ==, !=, ~ and !~");
+			return;
+		}
+
+		if (!ins.text && has) {
+			_fail("~ and !~ expect a string");
+			return;
+		}
+
+		_code.push_back(ins);
+	}
+};
+
+// Types of a table, shared by tables on any kind of window
+template <class T>
+struct TableTypes {
+	// Aliases
+	using Headers = std::vector <std::string>;
+	using Data = std::vector <T>;
+	using Generator = std::function <std::string (const T &, size_t)>;
+	using Lengths = std::vector <size_t>;
+	using Clock = std::chrono::steady_clock;
+
+	// Changed-cell flashing (disabled if decay is zero)
+	struct Flash {
+		std::chrono::milliseconds	decay {0};
+		int				attr = A_BOLD;
+	};
+
+	// Footer aggregates for each column
+	enum class Aggregate {
+		NONE,
+		SUM,
+		MIN,
+		MAX,
+		MEAN,
+		COUNT
+	};
+
+	using Aggregates = std::vector <Aggregate>;
+
+	// Numeric value of a column for aggregation (NaN to skip)
+	using Values = std::function <double (const T &, size_t)>;
+
+	// Attributes (and color pair) of a cell from its row,
+	//	column and value; only called for cells in view
+	using Style = std::function <int (size_t, size_t, const T &)>;
+
+	// Update structure
+	struct From {
+		Headers		headers;
+		Data		data;
+		Generator	generator;
+		Lengths		lengths;
+		Flash		flash;
+
+		// Footer (shown if any aggregate is set)
+		Aggregates	footer;
+		Values		values;
+		NumberFormat	footer_format;
+
+		// Conditional styling of cells
+		Style		style;
+
+		// Estimate auto lengths from at most this many rows
+		//	(0 to measure every row)
+		size_t		sample = 0;
+
+		bool		auto_resize = false;
+
+		// Constructor from headers and generator
+		From(const Headers &headers, Generator generator)
+				: headers(headers), generator(generator) {}
+	};
+};
+
+// Display a table on a window
+template <class T, class Base = PlainWindow>
+class Table : public Base {
+public:
+	// Aliases
+	using Headers = typename TableTypes <T> ::Headers;
+	using Data = typename TableTypes <T> ::Data;
+	using Generator = typename TableTypes <T> ::Generator;
+	using Lengths = typename TableTypes <T> ::Lengths;
+	using Clock = std::chrono::steady_clock;
+	using Flash = typename TableTypes <T> ::Flash;
+	using Aggregate = typename TableTypes <T> ::Aggregate;
+	using Aggregates = typename TableTypes <T> ::Aggregates;
+	using Values = typename TableTypes <T> ::Values;
+	using Style = typename TableTypes <T> ::Style;
+	using From = typename TableTypes <T> ::From;
+
+	// Members of the window the table is drawn on
+	using Base::info;
+	using Base::erase;
+	using Base::resize;
+	using Base::mvprintf;
+	using Base::mvadd_char;
+protected:
+	using Base::_main;
+	using Base::_flush;
+
+	Headers _headers;
+	Data _data;
+	Lengths _lengths;
+
+	// TODO: array of lengths for each column (either auto or specified)
+
+	// Function to generate columns from data
+	Generator _generator;
+
+	// First row in view and highlighted row
+	size_t _top = 0;
+	int _highlight = -1;
+
+	// Sampled lengths, refined by the widest cells seen since
+	Lengths _observed;
+	size_t _sample = 0;
+	bool _widen = false;
+
+	// Lengths were measured rather than given
+	bool _auto_lengths = false;
+
+	// Flash state: a fingerprint of the last rendered string
+	//	of each cell, and the deadlines of flashing cells
+	Flash _flash;
+	std::vector <uint32_t> _prints;
+	std::unordered_map <size_t, Clock::time_point> _flashing;
+	std::deque <std::pair <Clock::time_point, size_t>> _expiry;
+
+	// Running totals of a column; sums are compensated
+	//	(Neumaier) so that removals do not accumulate error,
+	//	and min/max are kept in an ordered multiset so that
+	//	removing the current extreme is O(log n)
+	struct Totals {
+		size_t			count = 0;
+		double			sum = 0;
+		double			carry = 0;
+		std::multiset <double>	ordered;
+
+		void accumulate(double v) {
+			double t = sum + v;
+			if (std::fabs(sum) >= std::fabs(v))
+				carry += (sum - t) + v;
+			else
+				carry += (v - t) + sum;
+			sum = t;
+		}
+
+		double total() const {
+			return sum + carry;
+		}
+	};
+
+	// Footer state
+	Aggregates _footer;
+	Values _values;
+	NumberFormat _footer_format;
+	std::vector <Totals> _totals;
+
+	// Cells in view, along with their style; the slot of a
+	//	row is reused by the rows a screen away, so scrolling
+	//	only generates the rows which came into view
+	struct Cached {
+		size_t		row = -1;
+		std::string	text;
+		int		attr = A_NORMAL;
+	};
+
+	Style _style;
+	std::vector <Cached> _cache;
+
+	// Search state, the rows matched so far are in order
+	TextSearch _search;
+	std::string _query;
+	std::vector <size_t> _found;
+	int _match_attr = A_UNDERLINE;
+	bool _stale = true;
+
+	// The search thread reads the rows of the table (rather than
+	//	a copy) until the buffer is built
+	bool _reading_rows = false;
+
+	// Filter state, the data rows shown (in order) if filtering
+	Filter _filter;
+	std::vector <size_t> _shown;
+	bool _filtering = false;
+
+	// Rows filtered in parallel, in chunks of at least this many
+	static constexpr size_t filter_chunk = 16384;
+
+	// Fingerprint of a cell string (FNV-1a), zero is reserved
+	//	for cells which have never been rendered
+	static uint32_t _fingerprint(const std::string &str) {
+		uint32_t hash = 2166136261u;
+		for (unsigned char c : str) {
+			hash ^= c;
+			hash *= 16777619u;
+		}
+
+		return hash ? hash : 1;
+	}
+
+	// Number of rows and their values, overriden by tables
+	//	which do not display _data directly
+	virtual size_t _row_count() const {
+		return _filtering ? _shown.size() : _data.size();
+	}
+
+	virtual const T &_value(size_t n) const {
+		return _data[_filtering ? _shown[n] : n];
+	}
+
+	// Generate the string of a cell
+	virtual std::string _cell(size_t n, size_t i) const {
+		return _generator(_value(n), i);
+	}
+
+	// Get lengths for each column, from evenly spaced
+	//	rows if sampling
+	void _get_lengths() {
+		_lengths = Lengths(_headers.size(), 0);
+		_observed.clear();
+		_widen = false;
+
+		size_t rows = _row_count();
+		size_t samples = (_sample && _sample < rows) ? _sample : rows;
+		for (size_t i = 0; i < _headers.size(); i++) {
+			_lengths[i] = DisplayWidth::columns(_headers[i]);
+			for (size_t k = 0; k < samples; k++) {
+				size_t n = (samples == rows) ? k : k * (rows / samples);
+				size_t l = DisplayWidth::columns(_cell(n, i));
+				if (l > _lengths[i])
+					_lengths[i] = l;
+			}
+
+			if (_has_footer()) {
+				_lengths[i] = std::max(_lengths[i],
+					DisplayWidth::columns(_footer_cell(i)));
+			}
+		}
+	}
+
+	// Check if a data row passes the filter
+	bool _passes(const T &d) const {
+		auto text = [&](size_t i) {
+			return _generator(d, i);
+		};
+
+		auto number = [&](size_t i) {
+			if (_values)
+				return _values(d, i);
+
+			// Parse the text, ignoring padding
+			std::string str = _generator(d, i);
+			const char *begin = str.data();
+			const char *end = begin + str.size();
+			while (begin < end && (*begin == ' ' || *begin == '+'))
+				begin++;
+
+			double v = NAN;
+			std::from_chars(begin, end, v);
+			return v;
+		};
+
+		return _filter.match(text, number);
+	}
+
+	// Filter every row, splitting the rows among threads
+	void _apply_filter() {
+		_shown.clear();
+
+		size_t rows = _data.size();
+		size_t workers = std::max(1u, std::thread::hardware_concurrency());
+		size_t chunks = std::min(workers, rows / filter_chunk + 1);
+		size_t per_chunk = (rows + chunks - 1) / chunks;
+
+		std::vector <std::vector <size_t>> parts(chunks);
+		auto work = [&](size_t c) {
+			size_t end = std::min(rows, (c + 1) * per_chunk);
+			for (size_t n = c * per_chunk; n < end; n++) {
+				if (_passes(_data[n]))
+					parts[c].push_back(n);
+			}
+		};
+
+		std::vector <std::thread> threads;
+		for (size_t c = 1; c < chunks; c++)
+			threads.emplace_back(work, c);
+
+		work(0);
+		for (auto &thread : threads)
+			thread.join();
+
+		for (const auto &part : parts)
+			_shown.insert(_shown.end(), part.begin(), part.end());
+	}
+
+	// Displayed row of a data row (-1 if filtered out)
+	size_t _shown_row(size_t n) const {
+		if (!_filtering)
+			return n;
+
+		auto it = std::lower_bound(_shown.begin(), _shown.end(), n);
+		if (it == _shown.end() || *it != n)
+			return -1;
+
+		return it - _shown.begin();
+	}
+
+	// Reset the view after rows have moved
+	void _rows_moved() {
+		// Rows have shifted under the fingerprints
+		_prints.clear();
+		_flashing.clear();
+		_expiry.clear();
+		_cache.clear();
+		_stale = true;
+
+		_top = std::min(_top, _row_count());
+
+		erase();
+		_write_table();
+		_flush();
+	}
+
+	// Text of a row in the search buffer, its cells each ended
+	//	by a unit separator
+	static void _search_text(const Generator &generator, const T &value,
+			size_t cols, std::string &out) {
+		for (size_t i = 0; i < cols; i++) {
+			out += generator(value, i);
+			out += '\x1f';
+		}
+	}
+
+	// Producer reading the rows of the table on the search thread;
+	//	it calls nothing virtual, as the table may be destroyed
+	//	while it runs (the destructors stop it)
+	virtual TextSearch::Producer _row_producer() {
+		size_t cols = _headers.size();
+		return [this, cols](size_t n, std::string &out) {
+			const T &value = _data[_filtering ? _shown[n] : n];
+			_search_text(_generator, value, cols, out);
+		};
+	}
+
+	// The rows are about to change: a search still building its
+	//	buffer from them carries on with a copy of the rows it has
+	//	not read yet, and the next search rebuilds the buffer
+	void _rows_changing() {
+		_stale = true;
+		if (!_reading_rows)
+			return;
+
+		_reading_rows = false;
+
+		bool running = _search.running();
+		_search.cancel();
+		if (!running) {
+			if (!_search.built())
+				_search.invalidate();
+
+			return;
+		}
+
+		TextSearch::Producer producer;
+		if (!_search.built()) {
+			size_t from = _search.produced();
+			size_t count = _row_count();
+
+			auto rows = std::make_shared <std::vector <T>> ();
+			rows->reserve(count - from);
+			for (size_t n = from; n < count; n++)
+				rows->push_back(_value(n));
+
+			auto generator = _generator;
+			size_t cols = _headers.size();
+			producer = [rows, from, generator, cols](size_t n, std::string &out) {
+				_search_text(generator, (*rows)[n - from], cols, out);
+			};
+		}
+
+		_found.clear();
+		_search.start(_query, _row_count(), producer);
+	}
+
+	// Resize the window to fit the whole table
+	void _fit() {
+		int height = _row_count() + (_has_footer() ? 6 : 4);
+		int width = 1;
+		for (const auto &l : _lengths)
+			width += l + 3;
+
+		// The window may be smaller than asked for (pads are
+		//	limited to PadWindow::max_size rows)
+		resize(height, width);
+		getmaxyx(_main, info.height, info.width);
+	}
+
+	// Scroll the least needed for a row to be in view
+	void _reveal(size_t row) {
+		if (row < _top)
+			_top = row;
+		else if (row - _top >= _rows_visible())
+			_top = row - std::max <size_t> (_rows_visible(), 1) + 1;
+	}
+
+	// Apply the lengths observed while drawing, in one batch
+	bool _refine_lengths() {
+		if (!_widen)
+			return false;
+
+		for (size_t i = 0; i < _lengths.size(); i++)
+			_lengths[i] = std::max(_lengths[i], _observed[i]);
+
+		_widen = false;
+		return true;
+	}
+
+	// Check if the footer is shown
+	bool _has_footer() const {
+		for (auto agg : _footer) {
+			if (agg != Aggregate::NONE)
+				return true;
+		}
+
+		return false;
+	}
+
+	// Check if a column needs its values ordered
+	bool _ordered(size_t i) const {
+		return i < _footer.size()
+			&& (_footer[i] == Aggregate::MIN
+			|| _footer[i] == Aggregate::MAX);
+	}
+
+	// Add (or remove) the contribution of a row to the totals
+	void _account(const T &d, bool add) {
+		for (size_t i = 0; i < _totals.size(); i++) {
+			if (i >= _footer.size() || _footer[i] == Aggregate::NONE)
+				continue;
+
+			double v = _values(d, i);
+			if (std::isnan(v))
+				continue;
+
+			Totals &t = _totals[i];
+			if (add) {
+				t.count++;
+				t.accumulate(v);
+				if (_ordered(i))
+					t.ordered.insert(v);
+			} else {
+				t.count--;
+				t.accumulate(-v);
+				auto it = t.ordered.find(v);
+				if (it != t.ordered.end())
+					t.ordered.erase(it);
+			}
+		}
+	}
+
+	// Recompute the totals from scratch
+	void _reset_totals() {
+		_totals.clear();
+		if (!_has_footer() || !_values)
+			return;
+
+		_totals.resize(_headers.size());
+		for (const auto &d : _data)
+			_account(d, true);
+	}
+
+	// Footer string of a column
+	std::string _footer_cell(size_t i) const {
+		if (i >= _totals.size() || i >= _footer.size())
+			return "";
+
+		const Totals &t = _totals[i];
+		switch (_footer[i]) {
+		case Aggregate::SUM:
+			return _footer_format(t.total());
+		case Aggregate::MIN:
+			return t.ordered.empty() ? "" : _footer_format(*t.ordered.begin());
+		case Aggregate::MAX:
+			return t.ordered.empty() ? "" : _footer_format(*t.ordered.rbegin());
+		case Aggregate::MEAN:
+			return t.count ? _footer_format(t.total() / t.count) : "";
+		case Aggregate::COUNT:
+			return _footer_format(t.count);
+		default:
+			break;
+		}
+
+		return "";
+	}
+
+	// Number of data rows that fit in the window
+	size_t _rows_visible() const {
+		int decorations = _has_footer() ? 6 : 4;
+		return std::max(info.height - decorations, 0);
+	}
+
+	// Window line of the footer
+	int _footer_line() const {
+		size_t rows = std::min(_row_count() - _top, _rows_visible());
+		return rows + 4;
+	}
+
+	// Window line of a data row, -1 if it is not in view
+	int _row_line(size_t n) const {
+		if (n < _top || n - _top >= _rows_visible())
+			return -1;
+
+		return n - _top + 3;
+	}
+
+	// Check if a freshly generated cell has changed since it
+	//	was last rendered, returns the attribute to draw with
+	int _check_flash(size_t n, size_t i, const std::string &str) {
+		size_t cell = n * _headers.size() + i;
+		if (cell >= _prints.size())
+			_prints.resize(_row_count() * _headers.size(), 0);
+
+		uint32_t print = _fingerprint(str);
+		uint32_t old = _prints[cell];
+		_prints[cell] = print;
+
+		if (old && old != print) {
+			auto deadline = Clock::now() + _flash.decay;
+			_flashing[cell] = deadline;
+			_expiry.push_back({deadline, cell});
+			return _flash.attr;
+		}
+
+		return _flashing.count(cell) ? _flash.attr : A_NORMAL;
+	}
+
+	// Get a cell in view from the cache, generating (and
+	//	styling) it if needed; fresh is set if it was
+	const Cached &_cached(size_t n, size_t i, bool &fresh) {
+		size_t cols = _headers.size();
+		size_t slots = std::max <size_t> (_rows_visible(), 1);
+		if (_cache.size() != slots * cols)
+			_cache.assign(slots * cols, Cached {});
+
+		Cached &cached = _cache[(n % slots) * cols + i];
+		fresh = (cached.row != n);
+		if (fresh) {
+			cached.row = n;
+			cached.text = _cell(n, i);
+			cached.attr = _style ? _style(n, i, _value(n)) : A_NORMAL;
+		}
+
+		return cached;
+	}
+
+	// Invalidate the cached cells of a row
+	void _invalidate(size_t n) {
+		for (auto &cached : _cache) {
+			if (cached.row == n)
+				cached.row = -1;
+		}
+	}
+
+	// Cut or pad a string to some columns
+	static std::string _pad(const std::string &text, size_t columns) {
+		std::string str = text.substr(0, DisplayWidth::prefix(text, columns));
+		str.append(columns - DisplayWidth::columns(str), ' ');
+		return str;
+	}
+
+	// Write a single cell (does not refresh)
+	void _write_cell(size_t n, size_t i) {
+		int line = _row_line(n);
+		if (line < 0)
+			return;
+
+		int x = 1;
+		for (size_t j = 0; j < i; j++)
+			x += _lengths[j] + 3;
+
+		bool fresh;
+		const Cached &cached = _cached(n, i, fresh);
+
+		int attr = cached.attr;
+		if (_highlight >= 0 && n == (size_t) _highlight)
+			attr |= A_REVERSE;
+
+		if (_flash.decay.count() > 0) {
+			if (fresh)
+				attr |= _check_flash(n, i, cached.text);
+			else if (_flashing.count(n * _headers.size() + i))
+				attr |= _flash.attr;
+		}
+
+		// Defer widening the column to the next tick
+		size_t columns = DisplayWidth::columns(cached.text);
+		if (fresh && _sample && columns > _lengths[i]) {
+			_observed.resize(_lengths.size(), 0);
+			_observed[i] = std::max(_observed[i], columns);
+			_widen = true;
+		}
+
+		// Pad string with spaces
+		std::string str = _pad(cached.text, _lengths[i]);
+
+		wattrset(_main, attr);
+		mvwprintw(_main, line, x, " %s ", str.c_str());
+
+		// Mark the matches of the search, as far as they show
+		if (!_query.empty()) {
+			size_t shown = DisplayWidth::prefix(cached.text, _lengths[i]);
+			std::string_view text = cached.text;
+
+			wattrset(_main, attr | _match_attr);
+			for (size_t at = text.find(_query); at < shown;
+					at = text.find(_query, at + _query.size())) {
+				size_t length = std::min(_query.size(), shown - at);
+				mvwaddnstr(_main, line, x + 1 + DisplayWidth::columns(text.substr(0, at)),
+					text.data() + at, length);
+			}
+		}
+
+		wattrset(_main, A_NORMAL);
+	}
+
+	// Write a single row (does not refresh)
+	void _write_row(size_t n) {
+		int line = _row_line(n);
+		if (line < 0)
+			return;
+
+		int x = 1;
+		for (size_t i = 0; i < _headers.size(); i++) {
+			_write_cell(n, i);
+			x += _lengths[i] + 3;
+			mvwaddch(_main, line, x - 1, ACS_VLINE);
+		}
+		mvwaddch(_main, line, 0, ACS_VLINE);
+	}
+
+	// Write a horizontal bar (does not refresh)
+	void _write_bar(int line, chtype left, chtype middle, chtype right) {
+		int x = 0;
+
+		mvwaddch(_main, line, 0, left);
+		for (size_t i = 0; i < _headers.size(); i++) {
+			for (int j = 0; j < _lengths[i] + 2; j++)
+				mvwaddch(_main, line, x + j + 1, ACS_HLINE);
+			x += _lengths[i] + 3;
+
+			if (i != _headers.size() - 1)
+				mvwaddch(_main, line, x, middle);
+			else
+				mvwaddch(_main, line, x, right);
+		}
+	}
+
+	// Write the footer line (does not refresh)
+	void _write_footer() {
+		int line = _footer_line();
+
+		int x = 1;
+		for (size_t i = 0; i < _headers.size(); i++) {
+			std::string str = _pad(_footer_cell(i), _lengths[i]);
+
+			mvwprintw(_main, line, x, " %s ", str.c_str());
+			x += _lengths[i] + 3;
+			mvwaddch(_main, line, x - 1, ACS_VLINE);
+		}
+		mvwaddch(_main, line, 0, ACS_VLINE);
+	}
+
+	// Write table
+	void _write_table() {
+		int line = 0;
+
+		// Write top bar
+		_write_bar(line, ACS_ULCORNER, ACS_TTEE, ACS_URCORNER);
+		line++;
+
+		// Write headers
+		int x = 1;
+		for (size_t i = 0; i < _headers.size(); i++) {
+			mvprintf(line, x, " %s ", _headers[i].c_str());
+			x += _lengths[i] + 3;
+			mvadd_char(line, x - 1, ACS_VLINE);
+		}
+		mvadd_char(line, 0, ACS_VLINE);
+		line++;
+
+		// Write middle bar
+		_write_bar(line, ACS_LTEE, ACS_PLUS, ACS_RTEE);
+		line++;
+
+		// Write the rows in view
+		size_t end = std::min(_row_count(), _top + _rows_visible());
+		for (size_t n = _top; n < end; n++) {
+			_write_row(n);
+			line++;
+		}
+
+		// Write the footer
+		if (_has_footer()) {
+			_write_bar(line, ACS_LTEE, ACS_PLUS, ACS_RTEE);
+			line++;
+
+			_write_footer();
+			line++;
+		}
+
+		// Write the bottom bar
+		_write_bar(line, ACS_LLCORNER, ACS_BTEE, ACS_LRCORNER);
+	}
+
+	// Constructor for derived tables, which lay out the table
+	//	(with _layout) once their own members are set up
+	struct Deferred {};
+
+	Table(Deferred, const From &from, int height, int width, int y, int x)
+			: Base(height, width, y, x),
+			_headers(from.headers), _data(from.data),
+			_lengths(from.lengths), _generator(from.generator),
+			_flash(from.flash), _footer(from.footer),
+			_values(from.values), _footer_format(from.footer_format),
+			_style(from.style) {}
+
+	// Measure and draw the table for the first time
+	void _layout(const From &from) {
+		// Compute the footer
+		_reset_totals();
+
+		// Get lengths (auto)
+		if (_lengths.empty()) {
+			_auto_lengths = true;
+			_sample = from.sample;
+			_get_lengths();
+		}
+
+		// Resize window if requested
+		if (from.auto_resize)
+			_fit();
+
+		// Write table
+		_write_table();
+
+		// Refresh all boxes
+		_flush();
+	}
+public:
+	// Default constructor
+	Table() = default;
+
+	// Constructors
+	Table(const From &from, int height, int width, int y, int x)
+			: Table(Deferred {}, from, height, width, y, x) {
+		_layout(from);
+	}
+
+	Table(const From &from, const ScreenInfo &info)
+			: Table(from,
+				info.height, info.width,
+				info.y, info.x
+			) {}
+
+	// Destructor, a search may still be reading the rows
+	virtual ~Table() {
+		_search.cancel();
+	}
+
+	// Update data
+	void set_data(const Data &data, bool auto_resize = false) {
+		// First, erase
+		erase();
+
+		_rows_changing();
+		_data = data;
+		if (_filtering)
+			_apply_filter();
+
+		_top = std::min(_top, _row_count());
+		_cache.clear();
+		_reset_totals();
+
+		if (auto_resize) {
+			_lengths.clear();
+			_get_lengths();
+			_fit();
+		}
+
+		_write_table();
+		_flush();
+	}
+
+	// Update a single row, only its cells (and the footer)
+	//	are redrawn
+	void set_row(size_t n, const T &value) {
+		if (!_totals.empty()) {
+			_account(_data[n], false);
+			_account(value, true);
+		}
+
+		_rows_changing();
+		_data[n] = value;
+
+		// Rows move if it enters or leaves the filter
+		size_t row = _shown_row(n);
+		if (_filtering && (row == size_t(-1)) == _passes(value)) {
+			if (row == size_t(-1))
+				_shown.insert(std::lower_bound(_shown.begin(), _shown.end(), n), n);
+			else
+				_shown.erase(_shown.begin() + row);
+
+			_rows_moved();
+			return;
+		}
+
+		if (row != size_t(-1)) {
+			_invalidate(row);
+			_write_row(row);
+		}
+
+		if (_has_footer())
+			_write_footer();
+
+		_flush();
+	}
+
+	// Append a row
+	void push_row(const T &value) {
+		_rows_changing();
+		_data.push_back(value);
+		if (!_totals.empty())
+			_account(value, true);
+
+		bool shown = !_filtering || _passes(value);
+		if (shown && _filtering)
+			_shown.push_back(_data.size() - 1);
+
+		// The bars below the rows only move if the new row is in view
+		if (shown && _row_line(_row_count() - 1) >= 0)
+			_write_table();
+		else if (_has_footer())
+			_write_footer();
+
+		_flush();
+	}
+
+	// Remove a row, which ends any flashing since the cells
+	//	below it are shifted up
+	void remove_row(size_t n) {
+		if (!_totals.empty())
+			_account(_data[n], false);
+
+		size_t row = _shown_row(n);
+
+		_rows_changing();
+		_data.erase(_data.begin() + n);
+
+		// Shift the shown rows below it
+		if (_filtering) {
+			auto it = std::lower_bound(_shown.begin(), _shown.end(), n);
+			if (row != size_t(-1))
+				it = _shown.erase(it);
+
+			for (; it != _shown.end(); it++)
+				(*it)--;
+		}
+
+		size_t cols = _headers.size();
+		if (row != size_t(-1) && _prints.size() >= (row + 1) * cols) {
+			_prints.erase(_prints.begin() + row * cols,
+				_prints.begin() + (row + 1) * cols);
+		}
+
+		_flashing.clear();
+		_expiry.clear();
+		_cache.clear();
+
+		erase();
+		_top = std::min(_top, _row_count());
+		_write_table();
+		_flush();
+	}
+
+	// Update lengths
+	void set_lengths(const Lengths &lengths) {
+		// First, erase
+		erase();
+
+		// Explicit lengths are not refined
+		_lengths = lengths;
+		_sample = 0;
+		_widen = false;
+		_auto_lengths = false;
+
+		_write_table();
+		_flush();
+	}
+
+	// Set the generator
+	void set_generator(const Generator &generator) {
+		// First, erase
+		erase();
+
+		_rows_changing();
+		_generator = generator;
+		_cache.clear();
+		_write_table();
+		_flush();
+	}
+
+	// Enable (or disable with a zero decay) changed-cell flashing
+	void set_flash(const Flash &flash) {
+		_flash = flash;
+		_flashing.clear();
+		_expiry.clear();
+		_cache.clear();
+
+		if (_flash.decay.count() <= 0)
+			_prints.clear();
+	}
+
+	// Set the conditional styling of cells
+	void set_style(const Style &style) {
+		_style = style;
+		_cache.clear();
+		_write_table();
+		_flush();
+	}
+
+	// Widen sampled columns to fit the cells seen since the
+	//	last tick, and expire flashed cells whose decay has
+	//	passed, redrawing only those cells; returns the
+	//	milliseconds until the next expiry (-1 if none),
+	//	suitable for wtimeout
+	int tick() {
+		auto now = Clock::now();
+
+		bool dirty = false;
+		if (_refine_lengths()) {
+			erase();
+			_write_table();
+			dirty = true;
+		}
+
+		while (!_expiry.empty() && _expiry.front().first <= now) {
+			auto [deadline, cell] = _expiry.front();
+			_expiry.pop_front();
+
+			// Skip if the cell has flashed again since
+			auto it = _flashing.find(cell);
+			if (it == _flashing.end() || it->second != deadline)
+				continue;
+
+			_flashing.erase(it);
+
+			size_t n = cell / _headers.size();
+			if (n < _row_count()) {
+				_write_cell(n, cell % _headers.size());
+				dirty = true;
+			}
+		}
+
+		if (dirty)
+			_flush();
+
+		// Poll frequently while searching
+		bool searching = _search.running();
+		_search.collect(_found);
+
+		int poll = searching ? 50 : -1;
+		if (_expiry.empty())
+			return poll;
+
+		auto left = std::chrono::duration_cast <std::chrono::milliseconds>
+			(_expiry.front().first - now);
+
+		int ms = std::max <int> (left.count(), 0);
+		return searching ? std::min(ms, poll) : ms;
+	}
+
+	// Show only the rows matching a filter expression (see
+	//	Filter), evaluated in parallel so the generator (and
+	//	values) must be safe to call from other threads; an
+	//	empty expression shows every row, returns false (and
+	//	sets error) if the expression does not compile
+	bool filter(const std::string &expr, std::string &error) {
+		if (!_filter.compile(expr, _headers, error))
+			return false;
+
+		// The search ends, and its buffer is of other rows
+		_search.invalidate();
+		_reading_rows = false;
+
+		_filtering = !_filter.empty();
+		if (_filtering)
+			_apply_filter();
+		else
+			_shown.clear();
+
+		_highlight = -1;
+		_found.clear();
+		_rows_moved();
+		return true;
+	}
+
+	// Data row of a displayed row
+	size_t data_row(size_t row) const {
+		return _filtering ? _shown[row] : row;
+	}
+
+	// Search for rows with a cell containing query (an empty
+	//	query ends the search); rows are read and scanned in
+	//	the background, so the generator must be safe to call
+	//	from another thread, and matches are collected by tick()
+	void search(const std::string &query, int attr = A_UNDERLINE) {
+		_query = query;
+		_match_attr = attr;
+		_found.clear();
+		_search.cancel();
+
+		if (!_query.empty()) {
+			if (_stale) {
+				_search.invalidate();
+				_reading_rows = false;
+			}
+
+			// The buffer is built from the rows themselves, until
+			//	they change (see _rows_changing)
+			TextSearch::Producer producer;
+			if (!_search.producing()) {
+				producer = _row_producer();
+				_reading_rows = true;
+			}
+
+			_stale = false;
+			_search.start(_query, _row_count(), producer);
+		}
+
+		_write_table();
+		_flush();
+	}
+
+	// Rows matched by the search so far
+	const std::vector <size_t> &matches() const {
+		return _found;
+	}
+
+	// Check if the search is still running
+	bool searching() const {
+		return _search.running();
+	}
+
+	// Highlight the next (or previous) matching row after
+	//	the highlighted one, returns false if there is none yet
+	bool search_next() {
+		_search.collect(_found);
+
+		size_t from = _highlight >= 0 ? _highlight + 1 : _top;
+		auto it = std::lower_bound(_found.begin(), _found.end(), from);
+		if (it == _found.end())
+			return false;
+
+		_reveal(*it);
+		highlight_row(*it);
+		return true;
+	}
+
+	bool search_prev() {
+		_search.collect(_found);
+
+		size_t before = _highlight >= 0 ? _highlight : _top;
+		auto it = std::lower_bound(_found.begin(), _found.end(), before);
+		if (it == _found.begin())
+			return false;
+
+		_reveal(*--it);
+		highlight_row(*it);
+		return true;
+	}
+
+	// Scroll so that row is the first in view
+	void scroll_to(size_t row) {
+		// First, erase
+		erase();
+
+		_top = std::min(row, _row_count());
+		_write_table();
+		_flush();
+	}
+
+	// Highlight a row
+	void highlight_row(int row) {
+		// First, erase
+		erase();
+
+		_highlight = row;
+		_write_table();
+		_flush();
+	}
+};
+
+// Table of hierarchical rows, children are loaded lazily
+//	when a row is first expanded
+template <class T, class Base = PlainWindow>
+class TreeTable : public Table <T, Base> {
+public:
+	// Aliases
+	using From = typename Table <T, Base> ::From;
+	using Loader = std::function <std::vector <T> (const T &)>;
+	using Leaf = std::function <bool (const T &)>;
+protected:
+	// Every node keeps a Fenwick tree over the number of
+	//	visible rows in each of its children's subtrees, so
+	//	that visible row k is found in O(depth * log n)
+	struct Node {
+		T			value;
+		size_t			parent;
+		size_t			index;
+		int			depth;
+		bool			loaded = false;
+		bool			expanded = false;
+
+		// Visible rows in this subtree (including itself)
+		size_t			size = 1;
+
+		std::vector <size_t>	children;
+		std::vector <size_t>	fenwick;
+	};
+
+	// Node 0 is an invisible, always expanded root
+	std::vector <Node> _nodes;
+
+	Loader _loader;
+	Leaf _leaf;
+
+	// Add delta to the ith child's entry
+	static void _fenwick_add(std::vector <size_t> &fenwick, size_t i, long delta) {
+		for (i++; i <= fenwick.size(); i += i & (~i + 1))
+			fenwick[i - 1] += delta;
+	}
+
+	// Sum of the entries of the children before i
+	static size_t _fenwick_prefix(const std::vector <size_t> &fenwick, size_t i) {
+		size_t sum = 0;
+		for (; i > 0; i -= i & (~i + 1))
+			sum += fenwick[i - 1];
+
+		return sum;
+	}
+
+	// Build a Fenwick tree over the children of a node, O(c)
+	void _build_fenwick(Node &node) {
+		node.fenwick.assign(node.children.size(), 0);
+		for (size_t i = 0; i < node.children.size(); i++)
+			node.fenwick[i] += _nodes[node.children[i]].size;
+
+		for (size_t i = 1; i <= node.fenwick.size(); i++) {
+			size_t j = i + (i & (~i + 1));
+			if (j <= node.fenwick.size())
+				node.fenwick[j - 1] += node.fenwick[i - 1];
+		}
+	}
+
+	// Add a child node
+	size_t _add_node(size_t parent, const T &value) {
+		Node node {value, parent, _nodes[parent].children.size(),
+			_nodes[parent].depth + 1, false, false, 1, {}, {}};
+		_nodes.push_back(std::move(node));
+
+		size_t id = _nodes.size() - 1;
+		_nodes[parent].children.push_back(id);
+		return id;
+	}
+
+	// Load the children of a node (once)
+	void _load(size_t id) {
+		if (_nodes[id].loaded)
+			return;
+
+		_nodes[id].loaded = true;
+		if (!_loader || (_leaf && _leaf(_nodes[id].value)))
+			return;
+
+		for (const auto &child : _loader(_nodes[id].value))
+			_add_node(id, child);
+
+		_build_fenwick(_nodes[id]);
+	}
+
+	// Propagate a change in visible rows up from a node
+	void _propagate(size_t id, long delta) {
+		_nodes[id].size += delta;
+		while (id != 0) {
+			size_t parent = _nodes[id].parent;
+			_fenwick_add(_nodes[parent].fenwick, _nodes[id].index, delta);
+			_nodes[parent].size += delta;
+			id = parent;
+		}
+	}
+
+	// Find the node at a visible row
+	size_t _node(size_t row) const {
+		size_t id = 0;
+		size_t k = row;
+
+		while (true) {
+			const Node &node = _nodes[id];
+
+			// Find the first child whose prefix sum exceeds k
+			size_t pos = 0;
+			size_t step = 1;
+			while (step * 2 <= node.fenwick.size())
+				step *= 2;
+
+			for (; step > 0; step /= 2) {
+				if (pos + step <= node.fenwick.size()
+						&& node.fenwick[pos + step - 1] <= k) {
+					pos += step;
+					k -= node.fenwick[pos - 1];
+				}
+			}
+
+			id = node.children[pos];
+			if (k == 0)
+				return id;
+
+			k--;
+		}
+	}
+
+	size_t _row_count() const override {
+		return _nodes[0].size - 1;
+	}
+
+	const T &_value(size_t n) const override {
+		return _nodes[_node(n)].value;
+	}
+
+	// Rows are read through the tree
+	TextSearch::Producer _row_producer() override {
+		size_t cols = this->_headers.size();
+		return [this, cols](size_t n, std::string &out) {
+			Table <T, Base> ::_search_text(this->_generator, _nodes[_node(n)].value, cols, out);
+		};
+	}
+
+	// Indent the first column and mark expandable rows
+	std::string _cell(size_t n, size_t i) const override {
+		const Node &node = _nodes[_node(n)];
+
+		std::string str = this->_generator(node.value, i);
+		if (i != 0)
+			return str;
+
+		char marker = ' ';
+		if (node.expanded)
+			marker = '-';
+		else if (!node.loaded ? !(_leaf && _leaf(node.value)) : !node.children.empty())
+			marker = '+';
+
+		std::string prefix((node.depth - 1) * 2, ' ');
+		prefix += marker;
+		prefix += ' ';
+		return prefix + str;
+	}
+
+	// Widen automatic lengths to fit rows which came into view;
+	//	sampled lengths are instead refined as rows are drawn
+	void _measure(size_t first, size_t count) {
+		if (!this->_auto_lengths || this->_sample)
+			return;
+
+		auto &lengths = this->_lengths;
+		for (size_t n = first; n < first + count; n++) {
+			for (size_t i = 0; i < lengths.size(); i++)
+				lengths[i] = std::max(lengths[i], DisplayWidth::columns(_cell(n, i)));
+		}
+	}
+
+	// Mutations (and filters) of _data do not apply to trees
+	using Table <T, Base> ::set_data;
+	using Table <T, Base> ::set_row;
+	using Table <T, Base> ::push_row;
+	using Table <T, Base> ::remove_row;
+	using Table <T, Base> ::filter;
+public:
+	// Default constructor
+	TreeTable() = default;
+
+	// Constructors, the roots of the tree are from.data (and
+	//	the footer aggregates the roots)
+	TreeTable(const From &from, const Loader &loader,
+			int height, int width, int y, int x,
+			const Leaf &leaf = Leaf {})
+			: Table <T, Base> (typename Table <T, Base> ::Deferred {},
+				from, height, width, y, x),
+			_loader(loader), _leaf(leaf) {
+		_nodes.push_back(Node {T {}, 0, 0, 0, true, true, 1, {}, {}});
+		for (const auto &root : from.data)
+			_add_node(0, root);
+
+		_nodes[0].size = _nodes[0].children.size() + 1;
+		_build_fenwick(_nodes[0]);
+
+		this->_layout(from);
+	}
+
+	TreeTable(const From &from, const Loader &loader,
+			const ScreenInfo &info, const Leaf &leaf = Leaf {})
+			: TreeTable(from, loader,
+				info.height, info.width,
+				info.y, info.x, leaf
+			) {}
+
+	// Destructor, the nodes go before the search is stopped
+	//	by the table
+	virtual ~TreeTable() {
+		this->_search.cancel();
+	}
+
+	// Number of visible rows
+	size_t rows() const {
+		return _row_count();
+	}
+
+	// Value and depth (starting at 0) of a visible row
+	const T &value(size_t row) const {
+		return _nodes[_node(row)].value;
+	}
+
+	int depth(size_t row) const {
+		return _nodes[_node(row)].depth - 1;
+	}
+
+	bool expanded(size_t row) const {
+		return _nodes[_node(row)].expanded;
+	}
+
+	// Expand a row, loading its children if needed
+	void expand(size_t row) {
+		size_t id = _node(row);
+		if (_nodes[id].expanded)
+			return;
+
+		this->_rows_changing();
+		_load(id);
+		_nodes[id].expanded = true;
+
+		const auto &fenwick = _nodes[id].fenwick;
+		size_t shown = _fenwick_prefix(fenwick, fenwick.size());
+		_propagate(id, shown);
+		_measure(row + 1, shown);
+		this->_rows_moved();
+	}
+
+	// Collapse a row, its children keep their own state
+	void collapse(size_t row) {
+		size_t id = _node(row);
+		if (!_nodes[id].expanded)
+			return;
+
+		this->_rows_changing();
+		_nodes[id].expanded = false;
+		_propagate(id, 1 - (long) _nodes[id].size);
+		this->_rows_moved();
+	}
+
+	void toggle(size_t row) {
+		if (expanded(row))
+			collapse(row);
+		else
+			expand(row);
+	}
+};
+
+// Log of edits for undo and redo; the text of all edits is kept
+//	in one string, consecutive typing (or erasing) coalesces into
+//	one entry per word, and the oldest entries are dropped when
+//	the log outgrows its budget
+class EditLog {
+public:
+	// Edit to apply to the text, and where the cursor goes; more
+	//	is set if the next undo (redo) belongs to the same step
+	struct Change {
+		bool insert;
+		size_t pos;
+		std::string_view text;
+		size_t cursor;
+		bool more;
+	};
+
+	static constexpr size_t default_budget = 1 << 20;
+
+	// Bytes of memory the log may use
+	void set_budget(size_t bytes) {
+		_budget = bytes;
+		_trim();
+	}
+
+	size_t memory() const {
+		return _bytes + _entries.size() * sizeof(Entry);
+	}
+
+	void clear() {
+		_entries.clear();
+		_text.clear();
+		_base = _bytes = _applied = 0;
+		_sealed = true;
+		_join = false;
+	}
+
+	bool can_undo() const {
+		return _applied > 0;
+	}
+
+	bool can_redo() const {
+		return _applied < _entries.size();
+	}
+
+	// End the current entry, e.g. when the cursor moves
+	void seal() {
+		_sealed = true;
+	}
+
+	// Make the next edit part of the same step as the last one
+	void join() {
+		_join = true;
+		_sealed = true;
+	}
+
+	// Record text inserted at pos
+	void inserted(size_t pos, std::string_view text) {
+		_drop_redo();
+
+		Entry *last = _last();
+		if (last && last->insert && pos == last->pos + last->length
+				&& !_word_start(text)) {
+			_append(*last, text);
+			return;
+		}
+
+		_push(pos, text, true, false);
+	}
+
+	// Record text erased at pos, backward if by backspace
+	void erased(size_t pos, std::string_view text, bool backward) {
+		_drop_redo();
+
+		// Backspaces prepend to the entry, so their text is
+		//	kept reversed
+		Entry *last = _last();
+		if (last && !last->insert && backward && last->backward
+				&& pos + text.size() == last->pos) {
+			_text.append(text.rbegin(), text.rend());
+			last->pos = pos;
+			last->length += text.size();
+			_bytes += text.size();
+			_trim();
+			return;
+		}
+
+		if (last && !last->insert && !backward && !last->backward
+				&& pos == last->pos) {
+			_append(*last, text);
+			return;
+		}
+
+		if (backward) {
+			std::string reversed(text.rbegin(), text.rend());
+			_push(pos, reversed, false, true);
+		} else {
+			_push(pos, text, false, false);
+		}
+	}
+
+	// Change that reverts the last step, false if none
+	bool undo(Change &change) {
+		if (_applied == 0)
+			return false;
+
+		const Entry &e = _entries[--_applied];
+		change.insert = !e.insert;
+		change.pos = e.pos;
+		change.text = _view(e);
+		change.cursor = (!e.insert && e.backward) ? e.pos + e.length : e.pos;
+		change.more = e.joined && _applied > 0;
+
+		_sealed = true;
+		return true;
+	}
+
+	// Change that repeats the last undone step, false if none
+	bool redo(Change &change) {
+		if (_applied == _entries.size())
+			return false;
+
+		const Entry &e = _entries[_applied++];
+		change.insert = e.insert;
+		change.pos = e.pos;
+		change.text = _view(e);
+		change.cursor = e.insert ? e.pos + e.length : e.pos;
+		change.more = _applied < _entries.size() && _entries[_applied].joined;
+
+		_sealed = true;
+		return true;
+	}
+protected:
+	struct Entry {
+		size_t pos;
+		size_t offset;		// Of the text, counted from the first byte ever logged
+		uint32_t length;
+		bool insert;
+		bool backward;		// Text is reversed
+		bool joined;		// Same step as the previous entry
+	};
+
+	std::deque <Entry> _entries;
+	std::string _text;
+	size_t _base = 0;		// Offset of _text[0]
+	size_t _bytes = 0;		// Text of the entries
+	size_t _applied = 0;		// Entries before this one are applied
+	size_t _budget = default_budget;
+	bool _sealed = true;
+	bool _join = false;
+
+	// Scratch for reversed text
+	std::string _reversed;
+
+	// Last entry, if the next edit may extend it
+	Entry *_last() {
+		if (_sealed || _entries.empty() || _entries.back().length >= UINT32_MAX / 2)
+			return nullptr;
+
+		return &_entries.back();
+	}
+
+	// A word starts after whitespace
+	bool _word_start(std::string_view text) const {
+		return !text.empty() && !std::isspace((unsigned char) text[0])
+			&& !_text.empty() && std::isspace((unsigned char) _text.back());
+	}
+
+	std::string_view _view(const Entry &e) {
+		std::string_view text(_text.data() + (e.offset - _base), e.length);
+		if (!e.backward)
+			return text;
+
+		_reversed.assign(text.rbegin(), text.rend());
+		return _reversed;
+	}
+
+	void _append(Entry &e, std::string_view text) {
+		_text += text;
+		e.length += text.size();
+		_bytes += text.size();
+		_trim();
+	}
+
+	void _push(size_t pos, std::string_view text, bool insert, bool backward) {
+		_entries.push_back(Entry {
+			pos, _base + _text.size(), (uint32_t) text.size(),
+			insert, backward, _join && !_entries.empty()
+		});
+
+		_text += text;
+		_bytes += text.size();
+		_applied = _entries.size();
+		_sealed = _join = false;
+		_trim();
+	}
+
+	// A new edit discards the undone entries, whose text is last
+	void _drop_redo() {
+		if (_applied == _entries.size())
+			return;
+
+		while (_entries.size() > _applied) {
+			_bytes -= _entries.back().length;
+			_entries.pop_back();
+		}
+
+		_text.resize(_entries.empty() ? 0
+			: _entries.back().offset + _entries.back().length - _base);
+
+		_sealed = true;
+	}
+
+	// Drop the oldest entries while over budget, compacting the
+	//	text once most of it is dead
+	void _trim() {
+		while (!_entries.empty() && memory() > _budget) {
+			// Only applied entries are dropped, undone ones
+			//	would be replayed in place of the next
+			if (_applied == 0) {
+				_drop_redo();
+				break;
+			}
+
+			_bytes -= _entries.front().length;
+			_entries.pop_front();
+			_applied--;
+
+			if (!_entries.empty())
+				_entries.front().joined = false;
+		}
+
+		size_t start = _entries.empty() ? _base + _text.size()
+			: _entries.front().offset;
+
+		if (start - _base > _text.size() / 2) {
+			_text.erase(0, start - _base);
+			_base = start;
+		}
+	}
+};
+
+// Gap buffer, a line of text with a gap near the cursor so that
+//	inserting and erasing at the cursor are amortized O(1); the
+//	gap only follows the cursor when the text is edited
+class GapBuffer {
+public:
+	// Default constructor
+	GapBuffer() = default;
+
+	// Constructor from text, the cursor is at the end
+	GapBuffer(std::string_view text)
+			: _buffer(text.begin(), text.end()),
+			_start(text.size()), _end(text.size()),
+			_cursor(text.size()) {}
+
+	// Length of the text
+	size_t size() const {
+		return _buffer.size() - (_end - _start);
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	// Position of the cursor
+	size_t cursor() const {
+		return _cursor;
+	}
+
+	// Character at a position
+	char operator[](size_t i) const {
+		return (i < _start) ? _buffer[i] : _buffer[i + (_end - _start)];
+	}
+
+	// Move the cursor
+	void move_to(size_t pos) {
+		_cursor = std::min(pos, size());
+	}
+
+	// Insert a character at the cursor
+	bool insert(char c) {
+		_move_gap(_cursor);
+		if (_start == _end)
+			_grow();
+
+		_buffer[_start++] = c;
+		_cursor++;
+		return true;
+	}
+
+	// Erase the character before (after) the cursor
+	bool erase_before() {
+		if (_cursor == 0)
+			return false;
+
+		_move_gap(_cursor);
+		_start--;
+		_cursor--;
+		return true;
+	}
+
+	bool erase_after() {
+		if (_cursor == size())
+			return false;
+
+		_move_gap(_cursor);
+		_end++;
+		return true;
+	}
+
+	// Contiguous view of count characters from a position; if the
+	//	gap splits the range it is moved to its nearer end, which
+	//	costs O(count) rather than O(size)
+	std::string_view view(size_t from, size_t count = std::string::npos) {
+		from = std::min(from, size());
+		count = std::min(count, size() - from);
+		if (from < _start && _start < from + count) {
+			if (_start - from < from + count - _start)
+				_move_gap(from);
+			else
+				_move_gap(from + count);
+		}
+
+		size_t offset = (from < _start) ? from : from + (_end - _start);
+		return std::string_view(_buffer.data() + offset, count);
+	}
+
+	// The whole text
+	std::string str() const {
+		std::string out(_buffer.begin(), _buffer.begin() + _start);
+		out.append(_buffer.begin() + _end, _buffer.end());
+		return out;
+	}
+protected:
+	std::vector <char> _buffer;
+	size_t _start = 0;
+	size_t _end = 0;
+	size_t _cursor = 0;
+
+	// Move the gap to a position, O(distance)
+	void _move_gap(size_t pos) {
+		size_t gap = _end - _start;
+		if (pos < _start) {
+			std::memmove(_buffer.data() + pos + gap,
+				_buffer.data() + pos, _start - pos);
+		} else if (pos > _start) {
+			std::memmove(_buffer.data() + _start,
+				_buffer.data() + _end, pos - _start);
+		}
+
+		_start = pos;
+		_end = pos + gap;
+	}
+
+	// Double the gap's share of the buffer
+	void _grow() {
+		size_t tail = _buffer.size() - _end;
+		size_t size = std::max <size_t> (16, _buffer.size() * 2);
+
+		_buffer.resize(size);
+		std::memmove(_buffer.data() + size - tail, _buffer.data() + _end, tail);
+		_end = size - tail;
+	}
+};
+
+// Line of at most N characters stored inline, for short fields
+//	such as numbers; same interface as GapBuffer
+template <size_t N>
+class InlineBuffer {
+public:
+	size_t size() const {
+		return _size;
+	}
+
+	bool empty() const {
+		return _size == 0;
+	}
+
+	size_t cursor() const {
+		return _cursor;
+	}
+
+	char operator[](size_t i) const {
+		return _text[i];
+	}
+
+	void move_to(size_t pos) {
+		_cursor = std::min(pos, _size);
+	}
+
+	// Insert a character at the cursor, fails if full
+	bool insert(char c) {
+		if (_size == N)
+			return false;
+
+		std::memmove(_text + _cursor + 1, _text + _cursor, _size - _cursor);
+		_text[_cursor++] = c;
+		_size++;
+		return true;
+	}
+
+	bool erase_before() {
+		if (_cursor == 0)
+			return false;
+
+		std::memmove(_text + _cursor - 1, _text + _cursor, _size - _cursor);
+		_cursor--;
+		_size--;
+		return true;
+	}
+
+	bool erase_after() {
+		if (_cursor == _size)
+			return false;
+
+		std::memmove(_text + _cursor, _text + _cursor + 1,
+			_size - _cursor - 1);
+		_size--;
+		return true;
+	}
+
+	std::string_view view(size_t from = 0,
+			size_t count = std::string::npos) const {
+		from = std::min(from, _size);
+		return std::string_view(_text + from, std::min(count, _size - from));
+	}
+
+	std::string str() const {
+		return std::string(_text, _size);
+	}
+protected:
+	char _text[N];
+	size_t _size = 0;
+	size_t _cursor = 0;
+};
+
+// IPv4 address, for address fields
+struct IPv4 {
+	uint8_t octets[4] = {0, 0, 0, 0};
+};
+
+// Yielders for upcoming FieldEditor class; each supported type
+//	has a Tyielder specialization, and Yielder holds any of them
+//	inline in a variant, so forms need no allocation per field
+struct base_yielder {
+	enum class Ret {
+		RET_NOP,
+		RET_PLUS,
+		RET_DEL,
+		RET_MOVE,
+		RET_REDRAW
+	};
+
+	// Whether a text is a value, the start of one, or neither
+	enum class Check {
+		INVALID,
+		PARTIAL,
+		VALID
+	};
+};
+
+// Line editing shared by the text based yielders; accept tells
+//	whether the text after an insertion is kept, deletions are
+//	always kept so that any text can be corrected. Ctrl-Z (or
+//	Ctrl-_, as Ctrl-Z suspends outside of raw mode) undoes and
+//	Ctrl-Y redoes
+template <class Buffer>
+struct line_yielder : public base_yielder {
+	Buffer buffer;
+
+	// The undo log is only made on the first edit, so that
+	//	fields which are never edited cost no allocation
+	std::unique_ptr <EditLog> history;
+	size_t budget = EditLog::default_budget;
+
+	line_yielder() = default;
+	line_yielder(line_yielder &&) = default;
+	line_yielder &operator=(line_yielder &&) = default;
+
+	line_yielder(const line_yielder &other)
+			: base_yielder(other), buffer(other.buffer),
+			history(other.history ? new EditLog(*other.history) : nullptr),
+			budget(other.budget) {}
+
+	line_yielder &operator=(const line_yielder &other) {
+		if (this != &other)
+			*this = line_yielder(other);
+
+		return *this;
+	}
+
+	void undo_budget(size_t bytes) {
+		budget = bytes;
+		if (history)
+			history->set_budget(bytes);
+	}
+
+	EditLog &_log() {
+		if (!history) {
+			history.reset(new EditLog);
+			history->set_budget(budget);
+		}
+
+		return *history;
+	}
+
+	// End the current undo step, if there is a log
+	void _seal() {
+		if (history)
+			history->seal();
+	}
+
+	// Apply the changes of an undo (redo) step
+	Ret _replay(bool undo) {
+		if (!history)
+			return Ret::RET_NOP;
+
+		EditLog::Change change;
+
+		bool any = false;
+		while (undo ? history->undo(change) : history->redo(change)) {
+			buffer.move_to(change.pos);
+			if (change.insert) {
+				for (char c : change.text)
+					buffer.insert(c);
+			} else {
+				for (size_t i = 0; i < change.text.size(); i++)
+					buffer.erase_after();
+			}
+
+			buffer.move_to(change.cursor);
+			any = true;
+
+			if (!change.more)
+				break;
+		}
+
+		return any ? Ret::RET_REDRAW : Ret::RET_NOP;
+	}
+
+	// Character steps, over whole UTF-8 sequences (of at most
+	//	four bytes, whatever the bytes are)
+	size_t _char_left(size_t i) const {
+		size_t stop = (i > 4) ? i - 4 : 0;
+		while (i > stop && (buffer[--i] & 0xC0) == 0x80);
+		return i;
+	}
+
+	size_t _char_right(size_t i) const {
+		size_t stop = std::min(i + 4, buffer.size());
+		if (i < stop)
+			i++;
+
+		while (i < stop && (buffer[i] & 0xC0) == 0x80)
+			i++;
+
+		return i;
+	}
+
+	// Word jumps, skipping spaces and then a word
+	size_t _word_left() const {
+		size_t i = buffer.cursor();
+		while (i > 0 && buffer[i - 1] == ' ')
+			i--;
+		while (i > 0 && buffer[i - 1] != ' ')
+			i--;
+
+		return i;
+	}
+
+	size_t _word_right() const {
+		size_t i = buffer.cursor();
+		while (i < buffer.size() && buffer[i] != ' ')
+			i++;
+		while (i < buffer.size() && buffer[i] == ' ')
+			i++;
+
+		return i;
+	}
+
+	template <class Accept>
+	Ret _edit(int ch, Accept accept) {
+		// Ctrl-Left and Ctrl-Right, if the terminal has them
+		static const int ctrl_left = key_defined("kLFT5");
+		static const int ctrl_right = key_defined("kRIT5");
+
+		size_t pos = buffer.cursor();
+		switch (ch) {
+		case KEY_BACKSPACE:
+		case 127:
+		case 8:
+			if (pos == 0)
+				return Ret::RET_NOP;
+
+			{
+				char text[4];
+				size_t start = _char_left(pos);
+				for (size_t i = start; i < pos; i++)
+					text[i - start] = buffer[i];
+
+				for (size_t i = start; i < pos; i++)
+					buffer.erase_before();
+
+				_log().erased(start, std::string_view(text, pos - start), true);
+			}
+
+			return Ret::RET_DEL;
+		case KEY_DC:
+			if (pos == buffer.size())
+				return Ret::RET_NOP;
+
+			{
+				char text[4];
+				size_t end = _char_right(pos);
+				for (size_t i = pos; i < end; i++)
+					text[i - pos] = buffer[i];
+
+				for (size_t i = pos; i < end; i++)
+					buffer.erase_after();
+
+				_log().erased(pos, std::string_view(text, end - pos), false);
+			}
+
+			return Ret::RET_DEL;
+		case 26: // Ctrl-Z
+		case 31: // Ctrl-_
+			return _replay(true);
+		case 25: // Ctrl-Y
+			return _replay(false);
+		case KEY_LEFT:
+			buffer.move_to(_char_left(pos));
+			break;
+		case KEY_RIGHT:
+			buffer.move_to(_char_right(pos));
+			break;
+		case KEY_HOME:
+		case 1: // Ctrl-A
+			buffer.move_to(0);
+			break;
+		case KEY_END:
+		case 5: // Ctrl-E
+			buffer.move_to(buffer.size());
+			break;
+		case KEY_SLEFT:
+			buffer.move_to(_word_left());
+			break;
+		case KEY_SRIGHT:
+			buffer.move_to(_word_right());
+			break;
+		default:
+			if (ch > 0 && ch == ctrl_left) {
+				buffer.move_to(_word_left());
+				break;
+			} else if (ch > 0 && ch == ctrl_right) {
+				buffer.move_to(_word_right());
+				break;
+			} else if (ch >= 0 && ch < 256 && std::isprint(ch) && buffer.insert(ch)) {
+				if (accept(buffer)) {
+					char c = ch;
+					_log().inserted(pos, std::string_view(&c, 1));
+					return Ret::RET_PLUS;
+				}
+
+				// Rejected, undo
+				buffer.erase_before();
+			}
+
+			return Ret::RET_NOP;
+		}
+
+		// Typing after a move starts a new undo step
+		_seal();
+		return (buffer.cursor() != pos) ? Ret::RET_MOVE : Ret::RET_NOP;
+	}
+};
+
+template <class T, class = void>
+struct Tyielder;
+
+// Specializations
+template <>
+struct Tyielder <std::string> : public line_yielder <GapBuffer> {
+	std::string *value;
+
+	// The buffer is loaded on the first key, so that fields
+	//	which are never touched are never copied
+	bool editing = false;
+
+	Tyielder(std::string *ptr) : value(ptr) {}
+
+	Ret proc(int ch) {
+		if (!editing) {
+			buffer = GapBuffer(*value);
+			editing = true;
+		}
+
+		return _edit(ch, [](const GapBuffer &) { return true; });
+	}
+
+	// Content of the field; the view is valid until the next
+	//	call to proc
+	std::string_view content() {
+		return editing ? buffer.view(0) : std::string_view(*value);
+	}
+
+	// Part of the content, without materializing the rest
+	std::string_view content(size_t from, size_t count) {
+		if (editing)
+			return buffer.view(from, count);
+
+		std::string_view all = *value;
+		return all.substr(std::min(from, all.size()), count);
+	}
+
+	// Length of the content
+	size_t length() const {
+		return editing ? buffer.size() : value->size();
+	}
+
+	// Position of the cursor in the content
+	size_t cursor() const {
+		return editing ? buffer.cursor() : value->size();
+	}
+
+	// Whether the content can be stored
+	bool valid() const {
+		return true;
+	}
+
+	// Store the edited content in the value
+	void commit() {
+		if (editing)
+			*value = buffer.str();
+	}
+
+	// Replace the content, the cursor goes to the end; this is
+	//	a single undo step
+	void assign(std::string_view text) {
+		std::string_view old = editing ? buffer.view(0) : std::string_view(*value);
+
+		EditLog &edits = _log();
+		edits.seal();
+		if (!old.empty()) {
+			edits.erased(0, old, false);
+			edits.join();
+		}
+
+		edits.inserted(0, text);
+		edits.seal();
+
+		buffer = GapBuffer(text);
+		editing = true;
+	}
+};
+
+// Fields parsed from their text, which is short and held inline;
+//	Derived::_check(text, value) parses the text and tells whether
+//	it is a value or the start of one, and keystrokes that lead to
+//	neither are rejected as they are typed
+template <class T, class Derived>
+struct parsed_yielder : public line_yielder <InlineBuffer <48>> {
+	using Buffer = InlineBuffer <48>;
+
+	T *value;
+
+	parsed_yielder(T *ptr) : value(ptr) {
+		char text[48];
+		char *end = Derived::_format(*ptr, text, text + sizeof(text));
+		for (char *c = text; c < end; c++)
+			buffer.insert(*c);
+	}
+
+	Ret proc(int ch) {
+		return _edit(ch, [](const Buffer &b) {
+			T parsed;
+			return Derived::_check(b.view(), parsed) != Check::INVALID;
+		});
+	}
+
+	std::string_view content() const {
+		return buffer.view();
+	}
+
+	std::string_view content(size_t from, size_t count) const {
+		return buffer.view(from, count);
+	}
+
+	size_t length() const {
+		return buffer.size();
+	}
+
+	size_t cursor() const {
+		return buffer.cursor();
+	}
+
+	bool valid() const {
+		T parsed;
+		return Derived::_check(buffer.view(), parsed) == Check::VALID;
+	}
+
+	// Incomplete text leaves the value untouched
+	void commit() {
+		T parsed;
+		if (Derived::_check(buffer.view(), parsed) == Check::VALID)
+			*value = parsed;
+	}
+};
+
+// Integers, an optional minus sign (for signed types) and digits
+template <class T>
+struct Tyielder <T, std::enable_if_t <std::is_integral_v <T>
+		&& !std::is_same_v <T, bool>>>
+		: public parsed_yielder <T, Tyielder <T>> {
+	using parsed_yielder <T, Tyielder <T>> ::parsed_yielder;
+
+	static char *_format(T v, char *begin, char *end) {
+		return std::to_chars(begin, end, v).ptr;
+	}
+
+	static base_yielder::Check _check(std::string_view text, T &out) {
+		using Check = base_yielder::Check;
+
+		if (text.empty() || (std::is_signed_v <T> && text == "-"))
+			return Check::PARTIAL;
+
+		// Out of range values and stray characters are invalid
+		const char *end = text.data() + text.size();
+		auto r = std::from_chars(text.data(), end, out);
+		return (r.ec == std::errc() && r.ptr == end)
+			? Check::VALID : Check::INVALID;
+	}
+};
+
+// Floating point, [-]digits[.digits][e[+-]digits]
+template <class T>
+struct Tyielder <T, std::enable_if_t <std::is_floating_point_v <T>>>
+		: public parsed_yielder <T, Tyielder <T>> {
+	using parsed_yielder <T, Tyielder <T>> ::parsed_yielder;
+
+	static char *_format(T v, char *begin, char *end) {
+		return std::to_chars(begin, end, v).ptr;
+	}
+
+	static base_yielder::Check _check(std::string_view text, T &out) {
+		using Check = base_yielder::Check;
+
+		// Walk the grammar, noting whether the text stops in
+		//	the middle of the mantissa or the exponent
+		size_t i = 0;
+		size_t n = text.size();
+		if (i < n && text[i] == '-')
+			i++;
+
+		size_t digits = 0;
+		while (i < n && std::isdigit((unsigned char) text[i]))
+			i++, digits++;
+
+		if (i < n && text[i] == '.') {
+			i++;
+			while (i < n && std::isdigit((unsigned char) text[i]))
+				i++, digits++;
+		}
+
+		bool complete = (digits > 0);
+		if (complete && i < n && (text[i] == 'e' || text[i] == 'E')) {
+			i++;
+			if (i < n && (text[i] == '+' || text[i] == '-'))
+				i++;
+
+			complete = (i < n && std::isdigit((unsigned char) text[i]));
+			while (i < n && std::isdigit((unsigned char) text[i]))
+				i++;
+		}
+
+		if (i < n)
+			return Check::INVALID;
+		if (!complete)
+			return Check::PARTIAL;
+
+		// Values out of range are invalid
+		auto r = std::from_chars(text.data(), text.data() + n, out);
+		return (r.ec == std::errc()) ? Check::VALID : Check::INVALID;
+	}
+};
+
+// IPv4 addresses in dotted decimal, each octet at most 255 and
+//	without leading zeros
+template <>
+struct Tyielder <IPv4> : public parsed_yielder <IPv4, Tyielder <IPv4>> {
+	using parsed_yielder <IPv4, Tyielder <IPv4>> ::parsed_yielder;
+
+	static char *_format(const IPv4 &ip, char *begin, char *end) {
+		for (int i = 0; i < 4; i++) {
+			if (i > 0)
+				*begin++ = '.';
+
+			begin = std::to_chars(begin, end, ip.octets[i]).ptr;
+		}
+
+		return begin;
+	}
+
+	static Check _check(std::string_view text, IPv4 &out) {
+		size_t octet = 0;
+		size_t start = 0;
+		for (size_t i = 0; i <= text.size(); i++) {
+			if (i < text.size() && text[i] != '.')
+				continue;
+
+			// Check the octet in [start, i)
+			std::string_view part = text.substr(start, i - start);
+			if (part.empty()) {
+				return (i == text.size() && octet < 4)
+					? Check::PARTIAL : Check::INVALID;
+			}
+
+			if (octet == 4 || part.size() > 3
+					|| (part.size() > 1 && part[0] == '0'))
+				return Check::INVALID;
+
+			unsigned v;
+			auto r = std::from_chars(part.data(), part.data() + part.size(), v);
+			if (r.ec != std::errc() || r.ptr != part.data() + part.size()
+					|| v > 255)
+				return Check::INVALID;
+
+			out.octets[octet++] = v;
+			start = i + 1;
+		}
+
+		return (octet == 4) ? Check::VALID : Check::PARTIAL;
+	}
+};
+
+// Choice among named values, for enums; left, right and space
+//	cycle through the names and a letter jumps to the next name
+//	starting with it
+struct choice_yielder : public base_yielder {
+	void *value;
+	void (*store)(void *, size_t);
+	const std::vector <std::string> *names;
+	size_t index;
+
+	Ret proc(int ch) {
+		size_t n = names->size();
+		if (n == 0)
+			return Ret::RET_NOP;
+
+		size_t next = index;
+		if (ch == KEY_LEFT) {
+			next = (index + n - 1) % n;
+		} else if (ch == KEY_RIGHT || ch == ' ') {
+			next = (index + 1) % n;
+		} else if (ch >= 0 && ch < 256 && std::isalnum(ch)) {
+			for (size_t i = 1; i <= n; i++) {
+				const std::string &name = (*names)[(index + i) % n];
+				if (!name.empty() && std::tolower(name[0]) == std::tolower(ch)) {
+					next = (index + i) % n;
+					break;
+				}
+			}
+		}
+
+		if (next == index)
+			return Ret::RET_NOP;
+
+		index = next;
+		return Ret::RET_PLUS;
+	}
+
+	std::string_view content() const {
+		return (index < names->size()) ? std::string_view((*names)[index]) : "";
+	}
+
+	std::string_view content(size_t from, size_t count) const {
+		std::string_view all = content();
+		return all.substr(std::min(from, all.size()), count);
+	}
+
+	size_t length() const {
+		return content().size();
+	}
+
+	// The whole name is redrawn on changes
+	size_t cursor() const {
+		return 0;
+	}
+
+	bool valid() const {
+		return index < names->size();
+	}
+
+	void commit() {
+		if (valid())
+			store(value, index);
+	}
+
+	// Choices are not logged
+	void undo_budget(size_t) {}
+};
+
+// Enums, whose values are 0, 1, ... and named by names, which must
+//	outlive the yield
+template <class T>
+struct Tyielder <T, std::enable_if_t <std::is_enum_v <T>>>
+		: public choice_yielder {
+	Tyielder(T *ptr, const std::vector <std::string> &names)
+			: choice_yielder {
+				{}, ptr,
+				[](void *p, size_t i) {
+					*static_cast <T *> (p) = static_cast <T> (i);
+				},
+				&names, static_cast <size_t> (*ptr)
+			} {}
+};
+
+// Field of a form, any of the yielders above
+class Yielder {
+public:
+	// Aliases
+	using Ret = base_yielder::Ret;
+	using Variant = std::variant <
+		Tyielder <std::string>,
+		Tyielder <short>,
+		Tyielder <unsigned short>,
+		Tyielder <int>,
+		Tyielder <unsigned int>,
+		Tyielder <long>,
+		Tyielder <unsigned long>,
+		Tyielder <long long>,
+		Tyielder <unsigned long long>,
+		Tyielder <float>,
+		Tyielder <double>,
+		Tyielder <IPv4>,
+		choice_yielder
+	>;
+
+	// Constructor
+	template <class T>
+	Yielder(const Tyielder <T> &yielder) : _yielder(yielder) {}
+
+	Ret proc(int ch) {
+		return std::visit([ch](auto &y) { return y.proc(ch); }, _yielder);
+	}
+
+	std::string_view content() {
+		return std::visit([](auto &y) { return y.content(); }, _yielder);
+	}
+
+	std::string_view content(size_t from, size_t count) {
+		return std::visit([&](auto &y) {
+			return y.content(from, count);
+		}, _yielder);
+	}
+
+	size_t length() const {
+		return std::visit([](auto &y) { return y.length(); }, _yielder);
+	}
+
+	size_t cursor() const {
+		return std::visit([](auto &y) { return y.cursor(); }, _yielder);
+	}
+
+	bool valid() const {
+		return std::visit([](auto &y) { return y.valid(); }, _yielder);
+	}
+
+	void commit() {
+		std::visit([](auto &y) { y.commit(); }, _yielder);
+	}
+
+	void undo_budget(size_t bytes) {
+		std::visit([bytes](auto &y) { y.undo_budget(bytes); }, _yielder);
+	}
+
+	// Replace the content of a text field, false for other fields
+	bool replace(std::string_view text) {
+		auto *text_field = std::get_if <Tyielder <std::string>> (&_yielder);
+		if (!text_field)
+			return false;
+
+		text_field->assign(text);
+		return true;
+	}
+protected:
+	Variant _yielder;
+};
+
+// Factory for Yielder
+template <class T>
+inline Yielder yielder(T *value)
+{
+	return Tyielder <T> {value};
+}
+
+// Factory for enum fields
+template <class T>
+inline Yielder yielder(T *value, const std::vector <std::string> &names)
+{
+	return Tyielder <T> {value, names};
+}
+
+// Sorted candidates for completing fields, packed in a single
+//	string with 32-bit offsets (so at most 4 GiB of text); the
+//	candidates with a given prefix are a contiguous range found
+//	by binary search. Build it once and share it between forms
+class CompletionIndex {
+public:
+	// Default constructor
+	CompletionIndex() = default;
+
+	// Constructor, duplicates are dropped
+	CompletionIndex(std::vector <std::string> words) {
+		std::sort(words.begin(), words.end());
+		words.erase(std::unique(words.begin(), words.end()), words.end());
+
+		size_t total = 0;
+		for (const auto &w : words)
+			total += w.size();
+
+		_text.reserve(total);
+		_offsets.reserve(words.size() + 1);
+		for (const auto &w : words) {
+			_offsets.push_back(_text.size());
+			_text += w;
+		}
+
+		_offsets.push_back(_text.size());
+	}
+
+	size_t size() const {
+		return _offsets.empty() ? 0 : _offsets.size() - 1;
+	}
+
+	std::string_view operator[](size_t i) const {
+		return std::string_view(_text.data() + _offsets[i],
+			_offsets[i + 1] - _offsets[i]);
+	}
+
+	// Range [first, last) of the candidates starting with prefix
+	std::pair <size_t, size_t> range(std::string_view prefix) const {
+		size_t first = _partition([&](std::string_view w) {
+			return w < prefix;
+		});
+
+		size_t last = _partition([&](std::string_view w) {
+			return w.substr(0, prefix.size()) <= prefix;
+		});
+
+		return {first, std::max(first, last)};
+	}
+protected:
+	std::string _text;
+	std::vector <uint32_t> _offsets;
+
+	// First candidate for which below is false, below being true
+	//	for a prefix of the candidates
+	template <class F>
+	size_t _partition(F below) const {
+		size_t lo = 0;
+		size_t hi = size();
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			if (below((*this)[mid]))
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		return lo;
+	}
+};
+
+// Validation of form fields off the input thread; checks are
+//	debounced per field, a newer edit replaces a queued check of
+//	the same field, and results of superseded checks are dropped
+class FieldValidation {
+public:
+	// Aliases
+	using Clock = std::chrono::steady_clock;
+
+	// Returns whether the text is valid, otherwise sets message
+	using Validator = std::function <bool (const std::string &, std::string &)>;
+
+	// Result of the latest check of a field
+	struct Status {
+		bool ok = true;
+		std::string message;
+	};
+
+	// Polling period while checks are running
+	static constexpr int poll_ms = 20;
+
+	FieldValidation() = default;
+	FieldValidation(const FieldValidation &) = delete;
+	FieldValidation &operator=(const FieldValidation &) = delete;
+
+	~FieldValidation() {
+		stop();
+	}
+
+	// Set the validator of a field, not while checks are running
+	void set(size_t field, const Validator &check, Clock::duration debounce) {
+		if (field >= _fields.size())
+			_fields.resize(field + 1);
+
+		_fields[field].check = check;
+		_fields[field].debounce = debounce;
+	}
+
+	bool has(size_t field) const {
+		return field < _fields.size() && _fields[field].check;
+	}
+
+	// Forget the results of earlier checks
+	void reset() {
+		for (auto &f : _fields) {
+			f.status = Status {};
+			f.pending = false;
+			f.done = f.generation;
+		}
+	}
+
+	// Schedule a check of a field after its debounce delay
+	void edited(size_t field, bool now = false) {
+		if (!has(field))
+			return;
+
+		Field &f = _fields[field];
+		f.generation++;
+		f.pending = true;
+		f.due = now ? Clock::now() : Clock::now() + f.debounce;
+	}
+
+	// Start scheduled checks without waiting for their delay
+	void flush() {
+		for (auto &f : _fields)
+			f.due = std::min(f.due, Clock::now());
+	}
+
+	// Queue the checks which are due, text(field) gives the text
+	//	of a field
+	template <class Text>
+	void submit(Text text) {
+		auto now = Clock::now();
+
+		bool queued = false;
+		for (size_t i = 0; i < _fields.size(); i++) {
+			Field &f = _fields[i];
+			if (!f.pending || f.due > now)
+				continue;
+
+			f.pending = false;
+
+			Job job {i, f.generation, f.check, text(i)};
+
+			std::lock_guard <std::mutex> guard(_lock);
+			auto it = std::find_if(_jobs.begin(), _jobs.end(),
+				[i](const Job &j) { return j.field == i; });
+
+			if (it != _jobs.end())
+				*it = std::move(job);
+			else
+				_jobs.push_back(std::move(job));
+
+			queued = true;
+		}
+
+		if (!queued)
+			return;
+
+		if (!_worker.joinable()) {
+			_stop = false;
+			_worker = std::thread(&FieldValidation::_run, this);
+		}
+
+		_wake.notify_one();
+	}
+
+	// Apply finished checks, adding the fields whose status
+	//	changed to changed; returns whether there were any
+	bool collect(std::vector <size_t> &changed) {
+		std::vector <Result> results;
+		{
+			std::lock_guard <std::mutex> guard(_lock);
+			results.swap(_results);
+		}
+
+		size_t before = changed.size();
+		for (auto &r : results) {
+			Field &f = _fields[r.field];
+			if (r.generation != f.generation)
+				continue;
+
+			f.done = r.generation;
+			if (f.status.ok != r.ok || f.status.message != r.message) {
+				f.status = Status {r.ok, std::move(r.message)};
+				changed.push_back(r.field);
+			}
+		}
+
+		return changed.size() > before;
+	}
+
+	const Status &status(size_t field) const {
+		static const Status ok;
+		return has(field) ? _fields[field].status : ok;
+	}
+
+	// Whether a check of the field is scheduled or running
+	bool busy(size_t field) const {
+		return has(field) && _fields[field].done != _fields[field].generation;
+	}
+
+	bool busy() const {
+		for (size_t i = 0; i < _fields.size(); i++) {
+			if (busy(i))
+				return true;
+		}
+
+		return false;
+	}
+
+	// Milliseconds to wait for input before attention is needed,
+	//	-1 if there is nothing to wait for
+	int wait_ms() const {
+		auto now = Clock::now();
+
+		int ms = -1;
+		for (size_t i = 0; i < _fields.size(); i++) {
+			const Field &f = _fields[i];
+
+			int wait;
+			if (f.pending) {
+				wait = std::max <long> (0,
+					std::chrono::duration_cast <std::chrono::milliseconds>
+					(f.due - now).count());
+			} else if (busy(i)) {
+				wait = poll_ms;
+			} else {
+				continue;
+			}
+
+			ms = (ms < 0) ? wait : std::min(ms, wait);
+		}
+
+		return ms;
+	}
+
+	// Stop the worker, dropping queued checks; waits for a
+	//	running check to return
+	void stop() {
+		{
+			std::lock_guard <std::mutex> guard(_lock);
+			_stop = true;
+			_jobs.clear();
+		}
+
+		_wake.notify_all();
+		if (_worker.joinable())
+			_worker.join();
+
+		_results.clear();
+	}
+protected:
+	struct Field {
+		Validator check;
+		Clock::duration debounce {};
+		Clock::time_point due;
+		bool pending = false;
+
+		// Generation of the latest edit, and of the latest result
+		size_t generation = 0;
+		size_t done = 0;
+
+		Status status;
+	};
+
+	struct Job {
+		size_t field;
+		size_t generation;
+		Validator check;
+		std::string text;
+	};
+
+	struct Result {
+		size_t field;
+		size_t generation;
+		bool ok;
+		std::string message;
+	};
+
+	std::vector <Field> _fields;
+
+	// Worker state, guarded by _lock
+	std::thread _worker;
+	std::mutex _lock;
+	std::condition_variable _wake;
+	std::deque <Job> _jobs;
+	std::vector <Result> _results;
+	bool _stop = false;
+
+	void _run() {
+		std::unique_lock <std::mutex> lock(_lock);
+		while (true) {
+			_wake.wait(lock, [this] { return _stop || !_jobs.empty(); });
+			if (_stop)
+				return;
+
+			Job job = std::move(_jobs.front());
+			_jobs.pop_front();
+
+			lock.unlock();
+
+			Result result {job.field, job.generation, false, ""};
+			result.ok = job.check(job.text, result.message);
+
+			lock.lock();
+			_results.push_back(std::move(result));
+		}
+	}
+};
+
+// Field editor window
+class FieldEditor : public DecoratedWindow {
+public:
+	// Aliases
+	using Fields = std::vector <std::string>;
+	using Validator = FieldValidation::Validator;
+	using Completions = std::shared_ptr <const CompletionIndex>;
+
+	// Most candidates shown at once
+	static constexpr int dropdown_rows = 6;
+protected:
+	Fields _fields;
+
+	// First field in view
+	int _top = 0;
+
+	// Checks of the fields, run in the background
+	FieldValidation _validation;
+
+	// Waiting for checks to finish before accepting
+	bool _confirm = false;
+
+	// Memory for the undo log of each field
+	size_t _undo_budget = EditLog::default_budget;
+
+	// Candidates of each field, and the open dropdown
+	std::vector <Completions> _completions;
+
+	struct Dropdown {
+		std::unique_ptr <BoxedWindow> window;
+		ScreenInfo area;
+		int field = -1;
+		size_t first = 0;
+		size_t count = 0;
+		size_t choice = 0;
+	} _dropdown;
+
+	// Quit flag
+	bool _quit = false;
+	bool _escape = false;
+
+	// Check movement input
+	bool _check_movement_input(int c, int &field) {
+		int fields = _fields.size();
+
+		switch (c) {
+		case KEY_UP:
+			if (field > 0)
+				field--;
+			return true;
+		case KEY_DOWN:
+			if (field < fields)
+				field++;
+			return true;
+		case KEY_PPAGE:
+			field = std::max(field - _visible_fields(), 0);
+			return true;
+		case KEY_NPAGE:
+			field = std::min(field + _visible_fields(), fields);
+			return true;
+		case 10: // Enter key
+			if (field == (int) _fields.size())
+				_quit = true;
+			return true;
+		case '\t':
+			// Cycle through fields
+			if (field == (int) _fields.size())
+				field = 0;
+			else
+				field++;
+
+			return true;
+		case 27: // Escape key
+			_escape = true;
+			_quit = true;
+			return true;
+		default:
+			break;
+		}
+
+		return false;
+	}
+
+	// Print ok button
+	void _print_ok(bool highlight) {
+		if (highlight)
+			attribute_set(A_REVERSE);
+
+		mvprintf(info.height - 6, info.width / 2 - 4, "[ OK ]");
+
+		if (highlight)
+			attribute_set(A_NORMAL);
+	}
+
+	// Number of field lines, the last two lines of the window hold
+	//	a blank line and the ok button
+	int _visible_fields() const {
+		return std::max(info.height - decoration_height - 2, 1);
+	}
+
+	// Scroll so that a field is in view, true if the view moved
+	bool _reveal(int field) {
+		if (field >= (int) _fields.size())
+			return false;
+
+		int top = _top;
+		if (field < top)
+			top = field;
+		else if (field >= top + _visible_fields())
+			top = field - _visible_fields() + 1;
+
+		if (top == _top)
+			return false;
+
+		_top = top;
+		return true;
+	}
+
+	// Print the label of a field, marked with ! if its check failed;
+	//	labels are padded, so the mark takes the last blank
+	void _print_label(int field) {
+		mvprintf(field - _top, 0, "%s  ", _fields[field].c_str());
+		if (!_validation.status(field).ok)
+			mvadd_char(field - _top, DisplayWidth::columns(_fields[field]) - 1, '!');
+	}
+
+	// Print the labels of the fields in view
+	void _print_labels() {
+		int end = std::min <int> (_top + _visible_fields(), _fields.size());
+		for (int field = _top; field < end; field++)
+			_print_label(field);
+	}
+
+	// Print the message of the focused field's failed check on the
+	//	line above the ok button
+	void _print_message(int field) {
+		int line = _visible_fields();
+		cursor(line, 0);
+		wclrtoeol(_main);
+
+		if (field < 0 || field >= (int) _fields.size() || _validation.status(field).ok)
+			return;
+
+		const std::string &message = _validation.status(field).message;
+		int width = std::max(info.width - 4, 0);
+
+		attribute_set(A_BOLD);
+		mvprintf(line, 0, "%.*s", width, message.c_str());
+		attribute_set(A_NORMAL);
+	}
+
+	// Queue due checks and show the finished ones
+	void _poll_validation(std::vector <Yielder> &yielders, int field) {
+		_validation.submit([&](size_t i) {
+			return std::string(yielders[i].content());
+		});
+
+		std::vector <size_t> changed;
+		if (!_validation.collect(changed))
+			return;
+
+		for (size_t i : changed) {
+			int line = i - _top;
+			if (line >= 0 && line < _visible_fields())
+				_print_label(i);
+		}
+
+		_print_message(field);
+		if (_dropdown.window)
+			_draw_dropdown();
+	}
+
+	// First field whose value is incomplete or whose latest check
+	//	failed, -1 if none; fields being checked again are skipped
+	int _first_invalid(std::vector <Yielder> &yielders) const {
+		for (int i = 0; i < (int) _fields.size(); i++) {
+			if (!yielders[i].valid())
+				return i;
+
+			if (!_validation.busy(i) && !_validation.status(i).ok)
+				return i;
+		}
+
+		return -1;
+	}
+
+	// Close the dropdown and repaint what it covered
+	void _close_dropdown() {
+		if (!_dropdown.window)
+			return;
+
+		_dropdown.window.reset();
+		_dropdown.field = -1;
+
+		touchwin(_box);
+		wrefresh(_box);
+		touchwin(_title);
+		wrefresh(_title);
+		touchwin(_main);
+		wrefresh(_main);
+	}
+
+	// Draw the dropdown below (or above) the field's line, within
+	//	the editor's box
+	void _draw_dropdown() {
+		int field = _dropdown.field;
+		size_t rows = std::min <size_t> (_dropdown.count, dropdown_rows);
+
+		// Widest candidate shown
+		size_t top = (_dropdown.choice >= rows) ? _dropdown.choice - rows + 1 : 0;
+		size_t widest = 0;
+		for (size_t i = top; i < top + rows; i++)
+			widest = std::max(widest, DisplayWidth::columns((*_completions[field])[_dropdown.first + i]));
+
+		int line = info.y + 4 + (field - _top);
+		int x = info.x + 1 + _layout[field].x;
+		int width = std::min <int> (widest + 2, info.x + info.width - x);
+		int height = rows + 2;
+
+		int y = line + 1;
+		if (y + height > info.y + info.height)
+			y = std::max(line - height, info.y);
+
+		height = std::min(height, info.y + info.height - y);
+		if (width < 3 || height < 3) {
+			_close_dropdown();
+			return;
+		}
+
+		ScreenInfo area {height, width, y, x};
+		if (!_dropdown.window || area.height != _dropdown.area.height
+				|| area.width != _dropdown.area.width
+				|| area.y != _dropdown.area.y || area.x != _dropdown.area.x) {
+			_close_dropdown();
+			_dropdown.field = field;
+			_dropdown.window = std::make_unique <BoxedWindow> (height, width, y, x);
+			_dropdown.area = area;
+		}
+
+		// Candidates, scrolled to the choice
+		BoxedWindow &win = *_dropdown.window;
+		win.erase();
+
+		rows = height - 2;
+		top = (_dropdown.choice >= rows) ? _dropdown.choice - rows + 1 : 0;
+		for (size_t r = 0; r < rows && top + r < _dropdown.count; r++) {
+			std::string_view word = (*_completions[field])[_dropdown.first + top + r];
+
+			win.attribute_set((top + r == _dropdown.choice) ? A_REVERSE : A_NORMAL);
+			int shown = DisplayWidth::prefix(word, width - 2);
+			win.mvprintf(r, 0, "%.*s", shown, word.data());
+		}
+
+		win.attribute_set(A_NORMAL);
+	}
+
+	// Show the candidates starting with the field's content
+	void _complete(int field, Yielder &yielder) {
+		if (field >= (int) _completions.size() || !_completions[field]) {
+			_close_dropdown();
+			return;
+		}
+
+		std::string_view prefix = yielder.content();
+		auto range = _completions[field]->range(prefix);
+
+		size_t count = range.second - range.first;
+		if (prefix.empty() || count == 0
+				|| (count == 1 && (*_completions[field])[range.first] == prefix)) {
+			_close_dropdown();
+			return;
+		}
+
+		if (_dropdown.field != field)
+			_close_dropdown();
+
+		_dropdown.field = field;
+		_dropdown.first = range.first;
+		_dropdown.count = count;
+		_dropdown.choice = 0;
+		_draw_dropdown();
+	}
+
+	// Keys for the open dropdown, true if handled
+	bool _dropdown_input(int c, Yielder &yielder) {
+		if (!_dropdown.window)
+			return false;
+
+		int field = _dropdown.field;
+		switch (c) {
+		case KEY_UP:
+			if (_dropdown.choice > 0)
+				_dropdown.choice--;
+			break;
+		case KEY_DOWN:
+			if (_dropdown.choice + 1 < _dropdown.count)
+				_dropdown.choice++;
+			break;
+		case 10: // Enter key, take the candidate
+			yielder.replace((*_completions[field])[_dropdown.first + _dropdown.choice]);
+			_close_dropdown();
+			_update_field(field, yielder, 0);
+			_validation.edited(field);
+			return true;
+		case 27: // Escape key, only close
+			_close_dropdown();
+			return true;
+		default:
+			return false;
+		}
+
+		_draw_dropdown();
+		return true;
+	}
+
+	// Next key, ERR if checks need attention first
+	int _next_key() {
+		wtimeout(_main, _validation.wait_ms());
+		return getc();
+	}
+
+	// Redraw the fields in view, and only those
+	void _draw_fields(std::vector <Yielder> &yielders) {
+		for (int line = 0; line < _visible_fields(); line++) {
+			cursor(line, 0);
+			wclrtoeol(_main);
+		}
+
+		_print_labels();
+
+		int end = std::min <int> (_top + _visible_fields(), _fields.size());
+		for (int field = _top; field < end; field++)
+			_update_field(field, yielders[field]);
+	}
+
+	// Display offsets of each field, computed once per yield
+	struct Layout {
+		int x;			// Column of the content
+		size_t width;		// Columns for the content
+		size_t scroll;		// First visible character
+	};
+
+	std::vector <Layout> _layout;
+
+	void _compute_layout() {
+		_layout.resize(_fields.size());
+		for (size_t i = 0; i < _fields.size(); i++) {
+			int x = DisplayWidth::columns(_fields[i]) + 2;
+			int avail = info.width - x - 4;
+
+			_layout[i] = {x, (size_t) std::max(avail, 1), 0};
+		}
+	}
+
+	// Update field, redrawing the content from position from
+	//	onwards (the whole line if the field scrolled); only the
+	//	visible part of the content is read
+	void _update_field(int field, Yielder &yielder, size_t from = 0) {
+		// Fields out of view are drawn when scrolled to
+		int line = field - _top;
+		if (line < 0 || line >= _visible_fields())
+			return;
+
+		Layout &layout = _layout[field];
+		size_t pos = yielder.cursor();
+
+		// Keep the cursor within the visible columns
+		size_t scroll = layout.scroll;
+		if (pos < scroll)
+			scroll = pos;
+		else if (_columns(yielder, scroll, pos, layout.width) >= layout.width)
+			scroll = _scroll_to(yielder, pos, layout.width - 1);
+
+		size_t x = 0;
+		if (scroll != layout.scroll || from < scroll) {
+			layout.scroll = scroll;
+			from = scroll;
+
+			// Reprint the label as well
+			cursor(line, 0);
+			wclrtoeol(_main);
+			_print_label(field);
+		} else if ((x = _columns(yielder, scroll, from, layout.width)) < layout.width) {
+			cursor(line, layout.x + x);
+			wclrtoeol(_main);
+		} else {
+			// Nothing visible changed
+			return;
+		}
+
+		// Reprint the visible content after from, reading no more
+		//	bytes than the columns left could take
+		size_t left = layout.width - x;
+		std::string_view substr = yielder.content(from, 4 * left);
+		substr = substr.substr(0, DisplayWidth::prefix(substr, left));
+
+		if (!substr.empty()) {
+			mvprintf(line, layout.x + x, "%.*s",
+				(int) substr.size(), substr.data());
+		}
+	}
+
+	// Columns of the content between two offsets, or at least
+	//	limit if there are more bytes than limit columns can take
+	static size_t _columns(Yielder &yielder, size_t from, size_t to, size_t limit) {
+		if (to - from > 4 * limit)
+			return limit;
+
+		return DisplayWidth::columns(yielder.content(from, to - from));
+	}
+
+	// First offset from which the content up to pos takes at most
+	//	some columns
+	static size_t _scroll_to(Yielder &yielder, size_t pos, size_t columns) {
+		size_t back = std::min(pos, 4 * columns + 4);
+		std::string_view text = yielder.content(pos - back, back);
+
+		// Characters of the text before pos, and their columns
+		std::vector <std::pair <size_t, int>> chars;
+		size_t i = 0;
+		while (i < text.size() && (text[i] & 0xC0) == 0x80)
+			i++;
+
+		while (i < text.size()) {
+			char32_t cp;
+			size_t length = DisplayWidth::decode(text, i, cp);
+			chars.emplace_back(i, length ? DisplayWidth::of(cp) : 1);
+			i += length ? length : 1;
+		}
+
+		size_t start = text.size();
+		size_t used = 0;
+		for (auto it = chars.rbegin(); it != chars.rend(); it++) {
+			if (used + it->second > columns)
+				break;
+
+			used += it->second;
+			start = it->first;
+		}
+
+		return pos - back + start;
+	}
+
+	// Place the cursor in a field
+	void _place_cursor(int field, Yielder &yielder) {
+		const Layout &layout = _layout[field];
+		size_t x = _columns(yielder, layout.scroll, yielder.cursor(), layout.width);
+		cursor(field - _top, layout.x + x);
+	}
+public:
+	// Default constructor
+	FieldEditor() = default;
+
+	// Constructor
+	// TODO: remove screeninfo parameter (make a separate constructor)
+	FieldEditor(const std::string &title, const Fields &fnames,
+			const ScreenInfo &info)
+			: DecoratedWindow(title, info), _fields(fnames) {
+		// Pad all fields with spaces
+		size_t max_len = 0;
+		for (const auto &f : _fields)
+			max_len = std::max(max_len, DisplayWidth::columns(f));
+
+		for (auto &f : _fields)
+			f.append(max_len + 2 - DisplayWidth::columns(f), ' ');
+
+		// Write the fields in view
+		_print_labels();
+
+		// Add [ OK ] button
+		_print_ok(false);
+	}
+
+	// Check a field with a validator, which runs on a background
+	//	thread once the field has not been edited for debounce;
+	//	the editor cannot be accepted while a check fails
+	void set_validator(size_t field, const Validator &check,
+			std::chrono::milliseconds debounce
+				= std::chrono::milliseconds(250)) {
+		_validation.set(field, check, debounce);
+	}
+
+	// Bytes of memory each field's undo log may use
+	void set_undo_budget(size_t bytes) {
+		_undo_budget = bytes;
+	}
+
+	// Complete a text field from a set of candidates, which may be
+	//	shared with other forms; matches are shown in a dropdown
+	//	as the field is typed in
+	void set_completions(size_t field, const Completions &completions) {
+		if (field >= _completions.size())
+			_completions.resize(field + 1);
+
+		_completions[field] = completions;
+	}
+
+	// Yield the fields
+	bool yield(std::vector <Yielder> &yielders) {
+		// Field index
+		int field = 0;
+
+		// Set keyboard input
+		keypad(_main, true);
+
+		// Turn off echo
+		noecho();
+
+		for (auto &y : yielders)
+			y.undo_budget(_undo_budget);
+
+		// Check all fields from the start
+		_validation.reset();
+		for (int i = 0; i < (int) _fields.size(); i++)
+			_validation.edited(i, true);
+
+		// Draw the fields in view
+		_compute_layout();
+		_top = 0;
+		_confirm = false;
+		_draw_fields(yielders);
+
+		// Move cursor
+		_place_cursor(0, yielders[0]);
+		curs_set(1);
+
+		// Get the fields
+		int c;
+		while ((c = _next_key())) {
+			// Checks to queue or results to show
+			_poll_validation(yielders, field);
+
+			if (c == ERR) {
+				if (!_confirm || _validation.busy()) {
+					if (field < (int) _fields.size())
+						_place_cursor(field, yielders[field]);
+
+					continue;
+				}
+
+				// Checks are done, press ok again
+				c = 10;
+			}
+
+			_confirm = false;
+
+			// Keys for the dropdown come first
+			if (field < (int) _fields.size() && _dropdown_input(c, yielders[field])) {
+				_place_cursor(field, yielders[field]);
+				continue;
+			}
+
+			// Check for movement inputs
+			bool moved = _check_movement_input(c, field);
+
+			// Check for quit, fields which do not hold a
+			//	complete value or fail their check keep the
+			//	editor open, and pending checks are waited for
+			if (_quit && !_escape) {
+				int invalid = _first_invalid(yielders);
+				if (invalid >= 0) {
+					field = invalid;
+					_quit = false;
+					beep();
+				} else if (_validation.busy()) {
+					_validation.flush();
+					_confirm = true;
+					_quit = false;
+				}
+			}
+
+			if (_quit)
+				break;
+
+			// Scroll to the field
+			if (_reveal(field))
+				_draw_fields(yielders);
+
+			if (moved) {
+				_close_dropdown();
+				_print_message(field);
+			}
+
+			// Highlight the ok button if needed
+			if (field >= (int) _fields.size()) {
+				curs_set(0);
+				_print_ok(true);
+				continue;
+			} else {
+				curs_set(1);
+				_print_ok(false);
+			}
+
+			// Yield the field, unless moved to it
+			Yielder &yielder = yielders[field];
+			size_t before = yielder.cursor();
+			auto ret = moved ? Yielder::Ret::RET_NOP : yielder.proc(c);
+
+			// Redraw what changed: the text after the edit, or
+			//	the whole field if the cursor left the view
+			size_t after = yielder.cursor();
+			if (ret == Yielder::Ret::RET_MOVE)
+				_update_field(field, yielder, std::string::npos);
+			else if (ret == Yielder::Ret::RET_REDRAW)
+				_update_field(field, yielder, 0);
+			else if (ret != Yielder::Ret::RET_NOP)
+				_update_field(field, yielder, std::min(before, after));
+
+			// Check the new text once typing pauses, and
+			//	show its completions
+			if (ret == Yielder::Ret::RET_PLUS || ret == Yielder::Ret::RET_DEL
+					|| ret == Yielder::Ret::RET_REDRAW) {
+				_validation.edited(field);
+				_complete(field, yielder);
+			}
+
+			// Move the cursor
+			_place_cursor(field, yielder);
+		}
+
+		// Disable cursor
+		curs_set(0);
+		wtimeout(_main, -1);
+		_validation.stop();
+		_close_dropdown();
+
+		// Store the edits
+		for (auto &y : yielders)
+			y.commit();
+
+		return (!_escape);
+	}
+
+	// Yield a temporary list of fields
+	bool yield(std::vector <Yielder> &&yielders) {
+		return yield(yielders);
+	}
+};
+
+
+// Text buffer for large texts, a piece table whose pieces are
+//	kept in a treap ordered by position; every node holds the
+//	length and number of line breaks of its subtree, so edits
+//	and line lookups take O(log n) (expected) time
+class TextBuffer {
+public:
+	// Default constructor
+	TextBuffer() = default;
+
+	// Constructor from text
+	TextBuffer(const std::string &text) {
+		assign(text);
+	}
+
+	// Replace the whole text
+	void assign(const std::string &text) {
+		_pieces.clear();
+		_free.clear();
+		_root = nil;
+
+		for (auto &source : _sources) {
+			source.text.clear();
+			source.breaks.clear();
+		}
+
+		_append(0, text.data(), text.size());
+		if (!text.empty())
+			_root = _node(0, 0, text.size());
+	}
+
+	// Load a file, returns false if it could not be read
+	bool load(const std::string &path) {
+		FILE *file = std::fopen(path.c_str(), "rb");
+		if (!file)
+			return false;
+
+		std::string text;
+		char chunk[1 << 16];
+
+		size_t n;
+		while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+			text.append(chunk, n);
+
+		bool ok = !std::ferror(file);
+		std::fclose(file);
+
+		if (ok)
+			assign(text);
+
+		return ok;
+	}
+
+	// Save to a file, returns false if it could not be written
+	bool save(const std::string &path) const {
+		FILE *file = std::fopen(path.c_str(), "wb");
+		if (!file)
+			return false;
+
+		bool ok = true;
+		_visit(_root, [&](const Piece &p) {
+			const std::string &text = _sources[p.source].text;
+			if (std::fwrite(text.data() + p.start, 1, p.length, file) != p.length)
+				ok = false;
+		});
+
+		return (std::fclose(file) == 0) && ok;
+	}
+
+	// Length of the text
+	size_t size() const {
+		return _size(_root);
+	}
+
+	// Number of lines (one more than the line breaks)
+	size_t lines() const {
+		return _breaks(_root) + 1;
+	}
+
+	// Insert text at an offset
+	void insert(size_t offset, const std::string &str) {
+		if (str.empty())
+			return;
+
+		size_t start = _sources[1].text.size();
+		_append(1, str.data(), str.size());
+
+		auto [left, right] = _split(_root, offset);
+		_root = _merge(_merge(left, _node(1, start, str.size())), right);
+	}
+
+	// Erase count characters from an offset
+	void erase(size_t offset, size_t count) {
+		auto [left, rest] = _split(_root, offset);
+		auto [middle, right] = _split(rest, count);
+
+		_release(middle);
+		_root = _merge(left, right);
+	}
+
+	// Offset of the start of a line
+	size_t line_start(size_t line) const {
+		if (line == 0)
+			return 0;
+
+		if (line >= lines())
+			return size();
+
+		// Find the (line)th line break
+		size_t k = line;
+		size_t offset = 0;
+
+		uint32_t t = _root;
+		while (t != nil) {
+			const Piece &p = _pieces[t];
+			if (k <= _breaks(p.left)) {
+				t = p.left;
+				continue;
+			}
+
+			k -= _breaks(p.left);
+			offset += _size(p.left);
+			if (k <= p.breaks) {
+				const auto &breaks = _sources[p.source].breaks;
+				auto it = std::lower_bound(breaks.begin(), breaks.end(), p.start);
+				return offset + (*(it + k - 1) - p.start) + 1;
+			}
+
+			k -= p.breaks;
+			offset += p.length;
+			t = p.right;
+		}
+
+		return size();
+	}
+
+	// Length of a line, excluding its line break
+	size_t line_length(size_t line) const {
+		size_t start = line_start(line);
+		if (line + 1 >= lines())
+			return size() - start;
+
+		return line_start(line + 1) - start - 1;
+	}
+
+	// Line containing an offset
+	size_t line_of(size_t offset) const {
+		size_t line = 0;
+
+		uint32_t t = _root;
+		while (t != nil) {
+			const Piece &p = _pieces[t];
+			if (offset < _size(p.left)) {
+				t = p.left;
+				continue;
+			}
+
+			line += _breaks(p.left);
+			offset -= _size(p.left);
+			if (offset < p.length)
+				return line + _count(p.source, p.start, offset);
+
+			line += p.breaks;
+			offset -= p.length;
+			t = p.right;
+		}
+
+		return line;
+	}
+
+	// Text of a line, excluding its line break
+	std::string line(size_t line) const {
+		return substr(line_start(line), line_length(line));
+	}
+
+	// Text in [offset, offset + count)
+	std::string substr(size_t offset, size_t count) const {
+		std::string out;
+		out.reserve(count);
+
+		// Walk down to the piece containing offset, keeping the
+		//	ancestors still to be visited on the right
+		std::vector <std::pair <uint32_t, size_t>> stack;
+
+		uint32_t t = _root;
+		while (t != nil) {
+			const Piece &p = _pieces[t];
+			if (offset < _size(p.left)) {
+				stack.push_back({t, 0});
+				t = p.left;
+			} else if (offset < _size(p.left) + p.length) {
+				stack.push_back({t, offset - _size(p.left)});
+				break;
+			} else {
+				offset -= _size(p.left) + p.length;
+				t = p.right;
+			}
+		}
+
+		// In order from there
+		while (!stack.empty() && out.size() < count) {
+			auto [n, skip] = stack.back();
+			stack.pop_back();
+
+			const Piece &p = _pieces[n];
+			size_t take = std::min(p.length - skip, count - out.size());
+			out.append(_sources[p.source].text, p.start + skip, take);
+
+			for (t = p.right; t != nil; t = _pieces[t].left)
+				stack.push_back({t, 0});
+		}
+
+		return out;
+	}
+
+	// The whole text
+	std::string str() const {
+		return substr(0, size());
+	}
+protected:
+	static constexpr uint32_t nil = -1;
+
+	// Original (0) and appended (1) text, and the offsets
+	//	of the line breaks in each
+	struct Source {
+		std::string		text;
+		std::vector <size_t>	breaks;
+	};
+
+	// Piece of a source, and the totals of its subtree
+	struct Piece {
+		uint32_t	left;
+		uint32_t	right;
+		uint32_t	priority;
+		uint8_t		source;
+		size_t		start;
+		size_t		length;
+		size_t		breaks;
+		size_t		total_length;
+		size_t		total_breaks;
+	};
+
+	Source			_sources[2];
+	std::vector <Piece>	_pieces;
+	std::vector <uint32_t>	_free;
+	uint32_t		_root = nil;
+	uint32_t		_seed = 2463534242u;
+
+	size_t _size(uint32_t t) const {
+		return (t == nil) ? 0 : _pieces[t].total_length;
+	}
+
+	size_t _breaks(uint32_t t) const {
+		return (t == nil) ? 0 : _pieces[t].total_breaks;
+	}
+
+	// Line breaks in [start, start + length) of a source
+	size_t _count(uint8_t source, size_t start, size_t length) const {
+		const auto &breaks = _sources[source].breaks;
+		auto lo = std::lower_bound(breaks.begin(), breaks.end(), start);
+		auto hi = std::lower_bound(lo, breaks.end(), start + length);
+		return hi - lo;
+	}
+
+	// Append to a source, indexing its line breaks
+	void _append(uint8_t source, const char *str, size_t n) {
+		Source &s = _sources[source];
+
+		size_t base = s.text.size();
+		s.text.append(str, n);
+
+		const char *p = str;
+		const char *end = str + n;
+		while ((p = (const char *) std::memchr(p, '\n', end - p))) {
+			s.breaks.push_back(base + (p - str));
+			p++;
+		}
+	}
+
+	// Allocate a node for a piece
+	uint32_t _node(uint8_t source, size_t start, size_t length) {
+		// Xorshift priorities
+		_seed ^= _seed << 13;
+		_seed ^= _seed >> 17;
+		_seed ^= _seed << 5;
+
+		Piece p {nil, nil, _seed, source, start, length,
+			_count(source, start, length), 0, 0};
+
+		uint32_t t;
+		if (!_free.empty()) {
+			t = _free.back();
+			_free.pop_back();
+			_pieces[t] = p;
+		} else {
+			t = _pieces.size();
+			_pieces.push_back(p);
+		}
+
+		_update(t);
+		return t;
+	}
+
+	// Free the nodes of a subtree
+	void _release(uint32_t t) {
+		if (t == nil)
+			return;
+
+		_release(_pieces[t].left);
+		_release(_pieces[t].right);
+		_free.push_back(t);
+	}
+
+	void _update(uint32_t t) {
+		Piece &p = _pieces[t];
+		p.total_length = p.length + _size(p.left) + _size(p.right);
+		p.total_breaks = p.breaks + _breaks(p.left) + _breaks(p.right);
+	}
+
+	// Split a subtree into the first offset characters and the rest
+	std::pair <uint32_t, uint32_t> _split(uint32_t t, size_t offset) {
+		if (t == nil)
+			return {nil, nil};
+
+		size_t left = _size(_pieces[t].left);
+		if (offset <= left) {
+			auto [a, b] = _split(_pieces[t].left, offset);
+			_pieces[t].left = b;
+			_update(t);
+			return {a, t};
+		}
+
+		size_t end = left + _pieces[t].length;
+		if (offset >= end) {
+			auto [a, b] = _split(_pieces[t].right, offset - end);
+			_pieces[t].right = a;
+			_update(t);
+			return {t, b};
+		}
+
+		// Split the piece itself, the second half takes the right
+		//	subtree (and the priority, which keeps it a heap)
+		size_t k = offset - left;
+		Piece p = _pieces[t];
+
+		uint32_t u = _node(p.source, p.start + k, p.length - k);
+		_pieces[u].priority = p.priority;
+		_pieces[u].right = p.right;
+		_update(u);
+
+		Piece &q = _pieces[t];
+		q.length = k;
+		q.breaks = _count(q.source, q.start, k);
+		q.right = nil;
+		_update(t);
+
+		return {t, u};
+	}
+
+	uint32_t _merge(uint32_t a, uint32_t b) {
+		if (a == nil)
+			return b;
+		if (b == nil)
+			return a;
+
+		if (_pieces[a].priority > _pieces[b].priority) {
+			_pieces[a].right = _merge(_pieces[a].right, b);
+			_update(a);
+			return a;
+		}
+
+		_pieces[b].left = _merge(a, _pieces[b].left);
+		_update(b);
+		return b;
+	}
+
+	// Visit the pieces in order
+	template <class F>
+	void _visit(uint32_t t, F f) const {
+		std::vector <uint32_t> stack;
+		while (t != nil || !stack.empty()) {
+			for (; t != nil; t = _pieces[t].left)
+				stack.push_back(t);
+
+			t = stack.back();
+			stack.pop_back();
+
+			f(_pieces[t]);
+			t = _pieces[t].right;
+		}
+	}
+};
+
+// Multi-line text editor, only the lines in view are drawn
+//	and long lines are wrapped at the width of the window
+class TextArea : public DecoratedWindow {
+protected:
+	TextBuffer *_buffer = nullptr;
+
+	// Cursor, and the column it tries to stay at when moving
+	//	between lines
+	size_t _line = 0;
+	size_t _col = 0;
+	size_t _goal = 0;
+
+	// First line in view, and its first row in view
+	size_t _top = 0;
+	size_t _top_row = 0;
+
+	// Rows taken by wrapped lines (cleared when lines move)
+	mutable std::unordered_map <size_t, size_t> _wraps;
+
+	// Edits, for undo and redo
+	EditLog _history;
+
+	bool _escape = false;
+	bool _quit = false;
+
+	// Size of the text area
+	size_t _width() const {
+		return std::max(info.width - 2, 1);
+	}
+
+	size_t _height() const {
+		return std::max(info.height - decoration_height, 1);
+	}
+
+	// Number of rows a line takes
+	size_t _rows(size_t line) const {
+		auto it = _wraps.find(line);
+		if (it != _wraps.end())
+			return it->second;
+
+		size_t length = _buffer->line_length(line);
+		size_t rows = std::max <size_t> ((length + _width() - 1) / _width(), 1);
+
+		// Account for the cursor sitting past a full row
+		if (length && length % _width() == 0)
+			rows++;
+
+		_wraps[line] = rows;
+		return rows;
+	}
+
+	// Scroll the least needed for the cursor to be in view
+	void _reveal() {
+		size_t row = _col / _width();
+		if (_line < _top || (_line == _top && row < _top_row)) {
+			_top = _line;
+			_top_row = row;
+			return;
+		}
+
+		// Rows from the top of the view to the cursor
+		size_t height = _height();
+		size_t rows = row + 1;
+		if (_line == _top) {
+			rows -= _top_row;
+		} else {
+			rows += _rows(_top) - _top_row;
+			for (size_t l = _top + 1; l < _line && rows <= height; l++)
+				rows += _rows(l);
+		}
+
+		if (rows <= height)
+			return;
+
+		// Walk back from the cursor to the new top
+		size_t l = _line;
+		size_t need = height - 1;
+		while (need > 0) {
+			if (row > 0) {
+				size_t take = std::min(row, need);
+				row -= take;
+				need -= take;
+			} else if (l > 0) {
+				row = _rows(--l) - 1;
+				need--;
+			} else {
+				break;
+			}
+		}
+
+		_top = l;
+		_top_row = row;
+	}
+
+	// Offset of the cursor in the buffer
+	size_t _offset() const {
+		return _buffer->line_start(_line) + _col;
+	}
+
+	// Move the cursor to an offset
+	void _seek(size_t offset) {
+		_line = _buffer->line_of(offset);
+		_col = offset - _buffer->line_start(_line);
+		_goal = _col;
+	}
+
+	// Draw the lines in view and place the cursor
+	void _write() {
+		werase(_main);
+
+		size_t width = _width();
+		size_t height = _height();
+
+		size_t row = 0;
+		size_t sub = _top_row;
+		int cy = -1;
+		int cx = 0;
+		for (size_t l = _top; l < _buffer->lines() && row < height; l++) {
+			std::string text = _buffer->line(l);
+			for (auto &c : text) {
+				if (c == '\t' || !std::isprint((unsigned char) c))
+					c = ' ';
+			}
+
+			size_t rows = _rows(l);
+			for (; sub < rows && row < height; sub++, row++) {
+				if (sub * width < text.size()) {
+					mvwaddnstr(_main, row, 0, text.data() + sub * width,
+						std::min(width, text.size() - sub * width));
+				}
+
+				if (l == _line && _col / width == sub) {
+					cy = row;
+					cx = _col % width;
+				}
+			}
+
+			sub = 0;
+		}
+
+		if (cy >= 0)
+			wmove(_main, cy, cx);
+
+		refresh();
+	}
+
+	// Line structure changed
+	void _lines_moved() {
+		_wraps.clear();
+	}
+
+	// Apply the changes of an undo (redo) step
+	void _replay(bool undo) {
+		EditLog::Change change;
+		while (undo ? _history.undo(change) : _history.redo(change)) {
+			if (change.insert)
+				_buffer->insert(change.pos, std::string(change.text));
+			else
+				_buffer->erase(change.pos, change.text.size());
+
+			_lines_moved();
+			_seek(change.cursor);
+			_goal = _col;
+
+			if (!change.more)
+				break;
+		}
+	}
+
+	// Handle a key
+	void _handle_key(int c) {
+		size_t lines = _buffer->lines();
+		size_t length = _buffer->line_length(_line);
+
+		// Typing after a move starts a new undo step
+		switch (c) {
+		case KEY_BACKSPACE:
+		case 127:
+		case 8:
+		case KEY_DC:
+		case KEY_ENTER:
+		case 10:
+		case 25:
+		case 26:
+		case 31:
+			break;
+		default:
+			if (c < 0 || c > 255 || !std::isprint(c))
+				_history.seal();
+			break;
+		}
+
+		switch (c) {
+		case KEY_LEFT:
+			if (_col > 0) {
+				_col--;
+			} else if (_line > 0) {
+				_line--;
+				_col = _buffer->line_length(_line);
+			}
+
+			_goal = _col;
+			return;
+		case KEY_RIGHT:
+			if (_col < length) {
+				_col++;
+			} else if (_line + 1 < lines) {
+				_line++;
+				_col = 0;
+			}
+
+			_goal = _col;
+			return;
+		case KEY_UP:
+			if (_line > 0) {
+				_line--;
+				_col = std::min(_goal, _buffer->line_length(_line));
+			}
+			return;
+		case KEY_DOWN:
+			if (_line + 1 < lines) {
+				_line++;
+				_col = std::min(_goal, _buffer->line_length(_line));
+			}
+			return;
+		case KEY_PPAGE:
+			_line -= std::min(_line, _height());
+			_col = std::min(_goal, _buffer->line_length(_line));
+			return;
+		case KEY_NPAGE:
+			_line = std::min(_line + _height(), lines - 1);
+			_col = std::min(_goal, _buffer->line_length(_line));
+			return;
+		case KEY_HOME:
+			_col = _goal = 0;
+			return;
+		case KEY_END:
+			_col = _goal = length;
+			return;
+		case KEY_BACKSPACE:
+		case 127:
+		case 8:
+			if (_offset() > 0) {
+				size_t offset = _offset() - 1;
+				if (_col == 0)
+					_lines_moved();
+				else
+					_wraps.erase(_line);
+
+				_history.erased(offset, _buffer->substr(offset, 1), true);
+				_buffer->erase(offset, 1);
+				_seek(offset);
+			}
+			return;
+		case KEY_DC:
+			if (_offset() < _buffer->size()) {
+				if (_col == length)
+					_lines_moved();
+				else
+					_wraps.erase(_line);
+
+				_history.erased(_offset(), _buffer->substr(_offset(), 1), false);
+				_buffer->erase(_offset(), 1);
+			}
+			return;
+		case 26: // Ctrl-Z
+		case 31: // Ctrl-_
+			_replay(true);
+			return;
+		case 25: // Ctrl-Y
+			_replay(false);
+			return;
+		case KEY_ENTER:
+		case 10:
+			_history.inserted(_offset(), "\n");
+			_buffer->insert(_offset(), "\n");
+			_lines_moved();
+			_line++;
+			_col = _goal = 0;
+			return;
+		case 24: // Ctrl-X, accept
+			_quit = true;
+			return;
+		case 27: // Escape key
+			_escape = true;
+			_quit = true;
+			return;
+		default:
+			break;
+		}
+
+		if (c >= 0 && c < 256 && std::isprint(c)) {
+			std::string text(1, c);
+			_history.inserted(_offset(), text);
+			_buffer->insert(_offset(), text);
+			_wraps.erase(_line);
+			_col++;
+			_goal = _col;
+		}
+	}
+public:
+	// Default constructor
+	TextArea() = default;
+
+	// Constructor
+	TextArea(const std::string &title, const ScreenInfo &info)
+			: DecoratedWindow(title, info) {}
+
+	// Bytes of memory the undo log may use
+	void set_undo_budget(size_t bytes) {
+		_history.set_budget(bytes);
+	}
+
+	// Edit a buffer until Ctrl-X (returns true) or
+	//	escape (returns false) is pressed
+	bool yield(TextBuffer &buffer) {
+		_buffer = &buffer;
+		_line = _col = _goal = 0;
+		_top = _top_row = 0;
+		_wraps.clear();
+		_history.clear();
+		_quit = _escape = false;
+
+		// Keyboard
+		keypad(_main, true);
+		noecho();
+		curs_set(1);
+
+		while (!_quit) {
+			_reveal();
+			_write();
+			_handle_key(getc());
+		}
+
+		curs_set(0);
+		return !_escape;
+	}
+};
+
+// Read only view of a file through mmap, with an index of its
+//	lines built in the background; the index keeps the offset of
+//	every index_stride-th line, so finding a line scans at most
+//	that many lines. The mapping reserves room for the file to
+//	grow (as logs do) without remapping
+class MappedFile {
+public:
+	// Lines between entries of the index
+	static constexpr size_t index_stride = 1024;
+
+	// Bytes indexed between publications of the index
+	static constexpr size_t index_batch = 16 << 20;
+
+	// Room reserved in the mapping for the file to grow
+	static constexpr size_t growth = 64 << 20;
+
+	// Bytes read at a time by the indexer
+	static constexpr size_t read_size = 256 << 10;
+
+	// Milliseconds the indexer waits for update to see a file
+	//	which came up short, before reading it again
+	static constexpr int retry_ms = 100;
+
+	static constexpr size_t npos = std::string_view::npos;
+
+	// Default constructor
+	MappedFile() = default;
+
+	// Not copyable (owns a mapping and a thread)
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	// Destructor
+	~MappedFile() {
+		close();
+	}
+
+	// Open a file and start indexing it, false on failure
+	bool open(const std::string &path) {
+		close();
+
+		_fd = ::open(path.c_str(), O_RDONLY);
+		if (_fd < 0)
+			return false;
+
+		struct stat st;
+		if (::fstat(_fd, &st) < 0 || !_map(st.st_size)) {
+			close();
+			return false;
+		}
+
+		_path = path;
+		_stop = false;
+		_indexer = std::thread(&MappedFile::_build, this);
+		return true;
+	}
+
+	void close() {
+		if (_indexer.joinable()) {
+			{
+				std::lock_guard <std::mutex> guard(_lock);
+				_stop = true;
+			}
+
+			_wake.notify_all();
+			_indexer.join();
+		}
+
+		for (auto &map : _maps)
+			::munmap(map.first, map.second);
+
+		if (_fd >= 0)
+			::close(_fd);
+
+		_maps.clear();
+		_fd = -1;
+		_data = nullptr;
+		_size = 0;
+		_indexed = 0;
+		_breaks = 0;
+		_offsets.assign(1, 0);
+		_failed = false;
+		_path.clear();
+	}
+
+	bool is_open() const {
+		return _fd >= 0;
+	}
+
+	const std::string &path() const {
+		return _path;
+	}
+
+	// Pick up a change in the size of the file, returns true if
+	//	it changed; a file truncated in place (as logs rotated by
+	//	copying are) is indexed again from the start, and its bytes
+	//	past the new end are no longer read
+	bool update() {
+		struct stat st;
+		if (_fd < 0 || ::fstat(_fd, &st) < 0 || (size_t) st.st_size == _size)
+			return false;
+
+		if ((size_t) st.st_size < _size) {
+			std::lock_guard <std::mutex> guard(_lock);
+			_size = st.st_size;
+			_indexed = 0;
+			_breaks = 0;
+			_offsets.assign(1, 0);
+			_failed = false;
+			_epoch++;
+		} else if (!_map(st.st_size)) {
+			return false;
+		}
+
+		_wake.notify_all();
+		_indexed_cv.notify_all();
+		return true;
+	}
+
+	// Bytes in the file, and the bytes themselves; both only
+	//	change in update, which is for the calling thread
+	size_t size() const {
+		return _size;
+	}
+
+	const char *data() const {
+		return _data;
+	}
+
+	std::string_view view(size_t offset, size_t count) const {
+		offset = std::min(offset, _size);
+		return std::string_view(_data + offset, std::min(count, _size - offset));
+	}
+
+	// Lines found so far, and whether the whole file is indexed
+	size_t lines() const {
+		std::lock_guard <std::mutex> guard(_lock);
+		return _lines();
+	}
+
+	bool indexed() const {
+		std::lock_guard <std::mutex> guard(_lock);
+		return _indexed == _size;
+	}
+
+	// Whether indexing stopped on an error reading the file; it
+	//	starts again from the beginning if the file is truncated
+	bool failed() const {
+		std::lock_guard <std::mutex> guard(_lock);
+		return _failed;
+	}
+
+	// Start of the line containing an offset
+	size_t line_start(size_t offset) const {
+		if (offset == 0 || _size == 0)
+			return 0;
+
+		offset = std::min(offset, _size);
+		const void *nl = ::memrchr(_data, '\n', offset);
+		return nl ? (const char *) nl - _data + 1 : 0;
+	}
+
+	// End of the line starting at an offset, before its break
+	size_t line_end(size_t offset) const {
+		const void *nl = std::memchr(_data + offset, '\n', _size - offset);
+		return nl ? (const char *) nl - _data : _size;
+	}
+
+	// Start of the next (previous) line, or the same offset
+	//	if there is none
+	size_t next_line(size_t start) const {
+		size_t end = line_end(start);
+		return (end + 1 < _size) ? end + 1 : start;
+	}
+
+	size_t prev_line(size_t start) const {
+		return (start > 0) ? line_start(start - 1) : 0;
+	}
+
+	// Start of the last line
+	size_t last_line() const {
+		return _size ? line_start(_size - 1) : 0;
+	}
+
+	// Number of the line starting at an offset, npos if it is
+	//	not indexed yet
+	size_t line_of(size_t offset) const {
+		size_t base, line;
+		{
+			std::lock_guard <std::mutex> guard(_lock);
+			if (offset > _indexed)
+				return npos;
+
+			auto it = std::upper_bound(_offsets.begin(), _offsets.end(), offset);
+			size_t i = (it - _offsets.begin()) - 1;
+			base = _offsets[i];
+			line = i * index_stride;
+		}
+
+		return line + std::count(_data + base, _data + offset, '\n');
+	}
+
+	// Offset of a line, npos if it is not indexed yet (or
+	//	past the end of the file)
+	size_t offset_of(size_t line) const {
+		size_t offset;
+		{
+			std::lock_guard <std::mutex> guard(_lock);
+			size_t i = line / index_stride;
+			if (line >= _lines() || i >= _offsets.size())
+				return npos;
+
+			offset = _offsets[i];
+		}
+
+		for (size_t k = line % index_stride; k > 0; k--)
+			offset = line_end(offset) + 1;
+
+		return offset;
+	}
+
+	// Wait until a line is indexed (or the whole file is, or
+	//	indexing failed), for at most a timeout; returns its
+	//	offset, npos if the file has fewer lines or the wait
+	//	timed out
+	size_t wait_for_line(size_t line, std::chrono::milliseconds timeout) {
+		std::unique_lock <std::mutex> lock(_lock);
+		_indexed_cv.wait_for(lock, timeout, [&]() {
+			return line < _lines() || _indexed == _size || _failed;
+		});
+
+		bool ready = line < _lines();
+		lock.unlock();
+
+		return ready ? offset_of(line) : npos;
+	}
+protected:
+	int _fd = -1;
+	std::string _path;
+
+	// Current mapping, and all mappings (kept so that views
+	//	handed out stay valid across remaps)
+	const char *_data = nullptr;
+	size_t _size = 0;
+	std::vector <std::pair <void *, size_t>> _maps;
+
+	// Index: bytes scanned, line breaks found and the offset
+	//	of every index_stride-th line
+	mutable std::mutex _lock;
+	std::condition_variable _wake;
+	std::condition_variable _indexed_cv;
+	size_t _indexed = 0;
+	size_t _breaks = 0;
+	std::vector <size_t> _offsets {0};
+	bool _failed = false;
+	bool _stop = false;
+
+	// Counts truncations, so that a batch indexed across one is
+	//	discarded
+	size_t _epoch = 0;
+	std::thread _indexer;
+
+	// Lines so far, a last line without a break counts once
+	//	the whole file is indexed
+	size_t _lines() const {
+		bool tail = _indexed == _size && _size > 0 && _data[_size - 1] != '\n';
+		return _breaks + (tail ? 1 : 0);
+	}
+
+	// Map the file at a size, reusing the mapping if it fits
+	bool _map(size_t size) {
+		if (!_maps.empty() && size <= _maps.back().second) {
+			std::lock_guard <std::mutex> guard(_lock);
+			_size = size;
+			return true;
+		}
+
+		size_t length = size + growth;
+		void *map = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, _fd, 0);
+		if (map == MAP_FAILED)
+			return false;
+
+		_maps.emplace_back(map, length);
+
+		std::lock_guard <std::mutex> guard(_lock);
+		_data = (const char *) map;
+		_size = size;
+		return true;
+	}
+
+	// Index the file, then wait for it to grow; the file is read
+	//	rather than mapped here, so that a truncation while a batch
+	//	is being indexed shortens the read instead of faulting
+	void _build() {
+		std::vector <size_t> found;
+		std::vector <char> buffer(read_size);
+
+		std::unique_lock <std::mutex> lock(_lock);
+		while (true) {
+			_wake.wait(lock, [&]() { return _stop || (_indexed < _size && !_failed); });
+			if (_stop)
+				break;
+
+			size_t from = _indexed;
+			size_t to = std::min(_size, from + index_batch);
+			size_t breaks = _breaks;
+			size_t epoch = _epoch;
+			lock.unlock();
+
+			found.clear();
+			size_t done = from;
+			bool error = false;
+			while (done < to) {
+				ssize_t n = ::pread(_fd, buffer.data(),
+					std::min(buffer.size(), to - done), done);
+				if (n < 0 && errno == EINTR)
+					continue;
+
+				if (n <= 0) {
+					error = (n < 0);
+					break;
+				}
+
+				const char *begin = buffer.data();
+				const char *end = begin + n;
+				for (const char *p = begin; (p = (const char *) std::memchr(p, '\n', end - p)); p++) {
+					if (++breaks % index_stride == 0)
+						found.push_back(done + (p - begin) + 1);
+				}
+
+				done += n;
+			}
+
+			lock.lock();
+			if (epoch != _epoch)
+				continue;
+
+			// Stop on an error, until the file is truncated
+			if (error) {
+				_failed = true;
+				_indexed_cv.notify_all();
+				continue;
+			}
+
+			// Cut short by a truncation: wait for update to see it,
+			//	and read again if it does not (the file may have
+			//	grown back in the meantime)
+			if (done < to) {
+				_wake.wait_for(lock, std::chrono::milliseconds(retry_ms),
+					[&]() { return _stop || epoch != _epoch; });
+				continue;
+			}
+
+			_offsets.insert(_offsets.end(), found.begin(), found.end());
+			_indexed = to;
+			_breaks = breaks;
+			_indexed_cv.notify_all();
+		}
+	}
+};
+
+// Pager in the manner of less, over a MappedFile; only the lines
+//	in view are read, and moving a page scans only the lines of
+//	that page, so the size of the file does not matter. Lines are
+//	numbered as the background index reaches them
+class Pager : public DecoratedWindow {
+public:
+	// Milliseconds between checks of the index (and of the file
+	//	while following it)
+	static constexpr int poll_ms = 100;
+
+	// Bytes searched between checks for a key
+	static constexpr size_t search_chunk = 32 << 20;
+
+	// Constructor
+	Pager(const std::string &title, const ScreenInfo &info)
+			: DecoratedWindow(title, info) {}
+
+	// Open a file, false on failure
+	bool open(const std::string &path) {
+		if (!_file.open(path))
+			return false;
+
+		_top = 0;
+		_left = 0;
+		return true;
+	}
+
+	const MappedFile &file() const {
+		return _file;
+	}
+
+	// Offset of the first line in view
+	size_t top() const {
+		return _top;
+	}
+
+	// Move the view, the first line in view is clamped so that
+	//	the last page is full
+	void scroll_by(long lines) {
+		for (; lines > 0 && _top < _last_top(); lines--)
+			_top = _file.next_line(_top);
+
+		for (; lines < 0 && _top > 0; lines++)
+			_top = _file.prev_line(_top);
+	}
+
+	void home() {
+		_top = 0;
+	}
+
+	void end() {
+		_top = _last_top();
+	}
+
+	// Show a line, waiting for the index to reach it; false if
+	//	the file has fewer lines
+	bool goto_line(size_t line) {
+		size_t offset = _file.wait_for_line(line, std::chrono::hours(24));
+		if (offset == MappedFile::npos)
+			return false;
+
+		_top = std::min(offset, _last_top());
+		return true;
+	}
+
+	// Show the next (previous) line containing a string, false
+	//	if there is none
+	bool search(const std::string &pattern, bool forward = true) {
+		_start_search(pattern, forward);
+		while (_search.active)
+			_search_step();
+
+		return _search.found;
+	}
+
+	// Page through the file until q or escape is pressed
+	void yield() {
+		noecho();
+		curs_set(0);
+		keypad(_main, true);
+
+		_quit = false;
+		while (!_quit) {
+			// Follow the end of the file as it grows
+			_update();
+			if (_follow)
+				end();
+
+			_write();
+
+			// Poll while something happens in the background
+			bool busy = _search.active || _pending != MappedFile::npos
+				|| _follow || !(_file.indexed() || _file.failed());
+			wtimeout(_main, _search.active ? 0 : (busy ? poll_ms : -1));
+
+			int c = getc();
+			_update();
+			if (_search.active) {
+				if (c == 27 || c == 'q') {
+					_search.active = false;
+					_message = "Search cancelled";
+				} else {
+					_search_step();
+				}
+			} else if (_pending != MappedFile::npos) {
+				if (c == 27 || c == 'q')
+					_pending = MappedFile::npos;
+				else
+					_goto_pending();
+			} else if (c != ERR) {
+				_handle_key(c);
+			}
+		}
+
+		wtimeout(_main, -1);
+		_follow = false;
+	}
+protected:
+	MappedFile _file;
+
+	// First line in view, and the first column
+	size_t _top = 0;
+	size_t _left = 0;
+
+	// Count typed before a command, line waited for in goto
+	size_t _count = 0;
+	size_t _pending = MappedFile::npos;
+
+	// Search in progress (or the last one, for n and N)
+	struct Search {
+		std::string pattern;
+		bool forward = true;
+		bool active = false;
+		bool found = false;
+
+		// Next offset to search from (forward) or to (backward),
+		//	and the last match
+		size_t next = 0;
+		size_t match = MappedFile::npos;
+	} _search;
+
+	std::string _message;
+	bool _follow = false;
+	bool _quit = false;
+
+	// Rows of text, the last row is the status line
+	size_t _rows() const {
+		return std::max(info.height - decoration_height - 1, 1);
+	}
+
+	size_t _width() const {
+		return std::max(info.width - 2, 1);
+	}
+
+	// First line in view with the last line at the bottom
+	size_t _last_top() const {
+		size_t top = _file.last_line();
+		for (size_t r = 1; r < _rows() && top > 0; r++)
+			top = _file.prev_line(top);
+
+		return top;
+	}
+
+	// Pick up a change in the size of the file, keeping the view
+	//	and the search inside it; the mapping is only read past
+	//	the end of a file truncated since the last update
+	void _update() {
+		if (!_file.update())
+			return;
+
+		size_t size = _file.size();
+		_top = (_top > _file.last_line()) ? _last_top() : _file.line_start(_top);
+		_left = std::min(_left, size);
+		_search.next = std::min(_search.next, size);
+		if (_search.match != MappedFile::npos && _search.match >= size)
+			_search.match = MappedFile::npos;
+	}
+
+	// Draw the lines in view and the status line
+	void _write() {
+		size_t offset = _top;
+		bool more = _file.size() > 0;
+
+		for (size_t r = 0; r < _rows(); r++) {
+			wmove(_main, r, 0);
+			wclrtoeol(_main);
+			if (!more)
+				continue;
+
+			size_t end = _file.line_end(offset);
+			std::string_view line = _file.view(offset, end - offset);
+			_write_line(r, line);
+			_highlight(r, line);
+
+			more = end + 1 < _file.size();
+			offset = end + 1;
+		}
+
+		_write_status();
+		refresh();
+	}
+
+	// Draw the columns of a line from the first column in view;
+	//	a wide character cut by the left edge is left out
+	void _write_line(size_t row, std::string_view line) {
+		size_t skip = DisplayWidth::prefix(line, _left);
+		size_t x = DisplayWidth::columns(line.substr(0, skip));
+		if (skip == line.size() && x < _left)
+			return;
+
+		if (x < _left) {
+			char32_t cp;
+			size_t length = DisplayWidth::decode(line, skip, cp);
+			skip += length ? length : 1;
+			x += length ? DisplayWidth::of(cp) : 1;
+		}
+
+		x -= _left;
+		line = line.substr(skip);
+
+		size_t width = _width();
+		wmove(_main, row, x);
+		_add_text(line.substr(0, DisplayWidth::prefix(line, width - x)));
+	}
+
+	// Highlight the matches of the last search on a row, in the
+	//	columns they take
+	void _highlight(size_t row, std::string_view line) {
+		const std::string &pattern = _search.pattern;
+		if (pattern.empty())
+			return;
+
+		size_t width = _width();
+		size_t at = 0;
+		size_t column = 0;
+		for (size_t i = line.find(pattern); i != std::string_view::npos;
+				i = line.find(pattern, i + 1)) {
+			column += DisplayWidth::columns(line.substr(at, i - at));
+			at = i;
+			if (column >= _left + width)
+				break;
+
+			size_t from = std::max(column, _left);
+			size_t to = std::min(column + DisplayWidth::columns(line.substr(i, pattern.size())),
+				_left + width);
+			if (from < to)
+				mvwchgat(_main, row, from - _left, to - from, A_REVERSE, 0, nullptr);
+		}
+	}
+
+	void _write_status() {
+		int row = _rows();
+		wmove(_main, row, 0);
+		wclrtoeol(_main);
+
+		std::string left = _message;
+		if (_search.active)
+			left = "Searching... (escape to cancel)";
+		else if (_pending != MappedFile::npos)
+			left = "Indexing... (escape to cancel)";
+		else if (_follow)
+			left = "Following (any key to stop)";
+		else if (left.empty())
+			left = _file.path();
+
+		// Line numbers as far as they are known
+		char status[64] = "";
+		size_t line = _file.line_of(_top);
+		size_t lines = _file.lines();
+		bool indexed = _file.indexed();
+		if (line != MappedFile::npos) {
+			std::snprintf(status, sizeof(status), "line %zu/%zu%s",
+				line + 1, lines, indexed ? "" : "+");
+		} else {
+			std::snprintf(status, sizeof(status), "%zu%%",
+				_file.size() ? (size_t) (100.0 * _top / _file.size()) : 100);
+		}
+
+		int width = _width();
+		int n = std::strlen(status);
+
+		wattron(_main, A_REVERSE);
+		mvwaddnstr(_main, row, 0, left.c_str(), std::max(width - n - 1, 0));
+		if (width > n)
+			mvwaddstr(_main, row, width - n, status);
+		wattroff(_main, A_REVERSE);
+	}
+
+	// Read a line of input on the status line, false if escaped
+	bool _prompt(const std::string &prompt, std::string &input) {
+		wtimeout(_main, -1);
+		input.clear();
+
+		int row = _rows();
+		while (true) {
+			wmove(_main, row, 0);
+			wclrtoeol(_main);
+			mvwaddnstr(_main, row, 0, (prompt + input).c_str(), _width());
+			refresh();
+
+			int c = getc();
+			switch (c) {
+			case 10:
+			case KEY_ENTER:
+				return true;
+			case 27:
+				return false;
+			case KEY_BACKSPACE:
+			case 127:
+			case 8:
+				if (input.empty())
+					return false;
+
+				input.pop_back();
+				break;
+			default:
+				if (c >= 0 && c < 256 && std::isprint(c))
+					input += c;
+				break;
+			}
+		}
+	}
+
+	// Searching proceeds a chunk at a time, so that it can be
+	//	cancelled; matches are looked for from the line after
+	//	(before) the first line in view, or the last match if
+	//	it is further along
+	void _start_search(const std::string &pattern, bool forward) {
+		size_t from = _top;
+		if (pattern == _search.pattern && _search.match != MappedFile::npos
+				&& _search.match >= _top)
+			from = _file.line_start(_search.match);
+
+		_search.pattern = pattern;
+		_search.forward = forward;
+		_search.active = !pattern.empty();
+		_search.found = false;
+		_search.match = MappedFile::npos;
+		_search.next = forward ? _file.line_end(from) + 1 : from;
+	}
+
+	void _search_step() {
+		_update();
+
+		const std::string &pattern = _search.pattern;
+		const char *data = _file.data();
+		size_t size = _file.size();
+
+		size_t match = MappedFile::npos;
+		if (_search.forward) {
+			// Chunks overlap by the length of the pattern
+			size_t from = std::min(_search.next, size);
+			size_t to = std::min(size, from + search_chunk + pattern.size());
+
+			const void *hit = ::memmem(data + from, to - from,
+				pattern.data(), pattern.size());
+			if (hit)
+				match = (const char *) hit - data;
+
+			_search.next = from + search_chunk;
+			if (!hit && to == size)
+				_search.active = false;
+		} else {
+			// The last match in a chunk ending at next
+			size_t to = _search.next;
+			size_t from = (to > search_chunk) ? to - search_chunk : 0;
+			size_t end = std::min(size, to + pattern.size() - 1);
+
+			for (size_t i = from; i < end; ) {
+				const void *hit = ::memmem(data + i, end - i,
+					pattern.data(), pattern.size());
+				if (!hit || (size_t) ((const char *) hit - data) >= to)
+					break;
+
+				match = (const char *) hit - data;
+				i = match + 1;
+			}
+
+			_search.next = from;
+			if (match == MappedFile::npos && from == 0)
+				_search.active = false;
+		}
+
+		if (match != MappedFile::npos) {
+			_top = std::min(_file.line_start(match), _last_top());
+			_search.match = match;
+			_search.active = false;
+			_search.found = true;
+			_message.clear();
+		} else if (!_search.active) {
+			_message = "Pattern not found";
+		}
+	}
+
+	// Go to the line waited for if it is indexed
+	void _goto_pending() {
+		size_t offset = _file.wait_for_line(_pending, std::chrono::milliseconds(0));
+		if (offset != MappedFile::npos) {
+			_top = std::min(offset, _last_top());
+			_pending = MappedFile::npos;
+		} else if (_file.indexed() || _file.failed()) {
+			_message = _file.failed() ? "Cannot read the file" : "No such line";
+			_top = _last_top();
+			_pending = MappedFile::npos;
+		}
+	}
+
+	void _handle_key(int c) {
+		// Any key stops following
+		if (_follow) {
+			_follow = false;
+			return;
+		}
+
+		// A count before a command
+		if (c >= '0' && c <= '9') {
+			_count = _count * 10 + (c - '0');
+			_message = ":" + std::to_string(_count);
+			return;
+		}
+
+		size_t count = std::max <size_t> (_count, 1);
+		bool counted = _count > 0;
+
+		_count = 0;
+		_message.clear();
+
+		long page = _rows();
+		switch (c) {
+		case KEY_DOWN:
+		case 'j':
+		case 10:
+			scroll_by(count);
+			break;
+		case KEY_UP:
+		case 'k':
+			scroll_by(-(long) count);
+			break;
+		case KEY_NPAGE:
+		case ' ':
+		case 'f':
+		case 6: // Ctrl-F
+			scroll_by(count * page);
+			break;
+		case KEY_PPAGE:
+		case 'b':
+		case 2: // Ctrl-B
+			scroll_by(-(long) count * page);
+			break;
+		case 'd':
+			scroll_by(count * page / 2);
+			break;
+		case 'u':
+			scroll_by(-(long) count * page / 2);
+			break;
+		case KEY_RIGHT:
+			_left += _width() / 2;
+			break;
+		case KEY_LEFT:
+			_left -= std::min(_left, _width() / 2);
+			break;
+		case KEY_HOME:
+		case 'g':
+		case 'G':
+		case KEY_END:
+			if (counted) {
+				_pending = count - 1;
+				_goto_pending();
+			} else if (c == KEY_HOME || c == 'g') {
+				home();
+			} else {
+				_update();
+				end();
+			}
+			break;
+		case 'F':
+			_follow = true;
+			break;
+		case '/':
+		case '?': {
+			std::string pattern;
+			if (_prompt(c == '/' ? "/" : "?", pattern) && !pattern.empty())
+				_start_search(pattern, c == '/');
+			break;
+		}
+		case 'n':
+		case 'N':
+			if (!_search.pattern.empty())
+				_start_search(_search.pattern, _search.forward == (c == 'n'));
+			break;
+		case 'q':
+		case 27:
+			_quit = true;
+			break;
+		}
+	}
+};
+
+// Bounded history of lines, keeping the last lines up to a count and
+//	a number of bytes; the text lives in one arena used as a ring,
+//	where a line that does not fit before the end of the arena
+//	starts over at its beginning, so every line stays contiguous
+class LogRing {
+public:
+	// Constructor, lines longer than the arena are cut
+	LogRing(size_t max_lines, size_t max_bytes)
+			: _entries(std::max <size_t> (max_lines, 1)),
+			_text(std::max <size_t> (max_bytes, 1)) {}
+
+	void append(std::string_view line) {
+		size_t capacity = _text.size();
+		line = line.substr(0, capacity);
+
+		// Skip to the start of the arena if the line would
+		//	run past its end
+		uint64_t pos = _end;
+		if (pos % capacity + line.size() > capacity)
+			pos += capacity - pos % capacity;
+
+		_end = pos + line.size();
+
+		// Drop the lines overwritten, or over the line limit
+		while (_count > 0 && (_count == _entries.size()
+				|| _entries[_first].pos + capacity < _end)) {
+			_first = (_first + 1) % _entries.size();
+			_count--;
+		}
+
+		std::memcpy(_text.data() + pos % capacity, line.data(), line.size());
+
+		_entries[(_first + _count) % _entries.size()] = Entry {pos, (uint32_t) line.size()};
+		_count++;
+		_total++;
+	}
+
+	void clear() {
+		_first = _count = 0;
+		_end = 0;
+	}
+
+	// Lines kept, and lines ever appended
+	size_t size() const {
+		return _count;
+	}
+
+	uint64_t total() const {
+		return _total;
+	}
+
+	// Sequence number of the oldest line kept
+	uint64_t first() const {
+		return _total - _count;
+	}
+
+	// Line by index, the oldest kept being 0
+	std::string_view operator[](size_t i) const {
+		const Entry &e = _entries[(_first + i) % _entries.size()];
+		return std::string_view(_text.data() + e.pos % _text.size(), e.length);
+	}
+protected:
+	// Lines are placed by a position which only grows, so the
+	//	bytes overwritten are those a capacity behind the end
+	struct Entry {
+		uint64_t pos;
+		uint32_t length;
+	};
+
+	std::vector <Entry> _entries;
+	std::vector <char> _text;
+
+	size_t _first = 0;
+	size_t _count = 0;
+	uint64_t _end = 0;
+	uint64_t _total = 0;
+};
+
+// Console for logs, keeping a bounded history in a LogRing; lines
+//	are cut at the width rather than wrapped. Appending only stores
+//	the lines, and flush (once per frame) shifts the window with
+//	the terminal's scrolling and draws the new rows alone. Scrolling
+//	back pins the view while lines keep arriving
+class LogView : public PlainWindow {
+public:
+	// Constructor, with the limits of the history
+	LogView(const ScreenInfo &info, size_t max_lines = 10000,
+			size_t max_bytes = 1 << 20)
+			: PlainWindow(info), _ring(max_lines, max_bytes) {
+		// Let ncurses shift lines with the terminal
+		idlok(_main, true);
+		keypad(_main, true);
+	}
+
+	// Add lines, one per newline (a final one is optional)
+	void append(std::string_view text) {
+		size_t start = 0;
+		while (start < text.size()) {
+			size_t end = text.find('\n', start);
+			if (end == std::string_view::npos)
+				end = text.size();
+
+			_ring.append(text.substr(start, end - start));
+			start = end + 1;
+		}
+	}
+
+	template <typename ... Args>
+	void printf(const char *str, Args ... args) {
+		char line[1024];
+		int n = std::snprintf(line, sizeof(line), str, args...);
+		append(std::string_view(line, std::min <size_t> (std::max(n, 0), sizeof(line) - 1)));
+	}
+
+	const LogRing &history() const {
+		return _ring;
+	}
+
+	// Check if the view shows the newest lines
+	bool following() const {
+		return _follow;
+	}
+
+	// Scroll back (forward if negative) by some lines; the view
+	//	follows new lines again when it reaches them
+	void scroll_back(long lines) {
+		uint64_t end = _end();
+		uint64_t oldest = _ring.first() + std::min <uint64_t> (_rows(), _ring.size());
+
+		if (lines > 0)
+			end -= std::min <uint64_t> (lines, end > oldest ? end - oldest : 0);
+		else
+			end += -lines;
+
+		_follow = end >= _ring.total();
+		_pinned = end;
+		_full = true;
+	}
+
+	void follow() {
+		_follow = true;
+		_full = true;
+	}
+
+	// Handle a scrolling key, false if it is not one
+	bool handle_key(int c) {
+		long page = _rows();
+		switch (c) {
+		case KEY_UP:
+			scroll_back(1);
+			break;
+		case KEY_DOWN:
+			scroll_back(-1);
+			break;
+		case KEY_PPAGE:
+			scroll_back(page);
+			break;
+		case KEY_NPAGE:
+			scroll_back(-page);
+			break;
+		case KEY_HOME:
+			scroll_back(_ring.size());
+			break;
+		case KEY_END:
+			follow();
+			break;
+		default:
+			return false;
+		}
+
+		return true;
+	}
+
+	// Draw what changed since the last flush
+	void flush() {
+		uint64_t end = _end();
+		uint64_t shift = end - _drawn;
+		size_t rows = _rows();
+
+		if (_full || _drawn > end || shift >= rows) {
+			_draw(end, rows);
+		} else if (shift > 0) {
+			// Shift the old rows up and draw the new ones
+			scrollok(_main, true);
+			wscrl(_main, shift);
+			scrollok(_main, false);
+
+			_draw(end, shift);
+		}
+
+		_drawn = end;
+		_full = false;
+		refresh();
+	}
+protected:
+	LogRing _ring;
+
+	// One past the line at the bottom when not following, and
+	//	when last drawn (so zero before any line)
+	uint64_t _pinned = 0;
+	uint64_t _drawn = 0;
+	bool _follow = true;
+	bool _full = true;
+
+	size_t _rows() const {
+		return std::max(info.height, 1);
+	}
+
+	// One past the sequence number of the line at the bottom;
+	//	pinned lines which have since been dropped give way to
+	//	the oldest kept
+	uint64_t _end() const {
+		uint64_t end = _ring.total();
+		if (_follow)
+			return end;
+
+		uint64_t oldest = _ring.first() + std::min <uint64_t> (_rows(), _ring.size());
+		return std::min(std::max(_pinned, oldest), end);
+	}
+
+	// Draw the bottom rows of the view, ending before a line
+	void _draw(uint64_t end, size_t count) {
+		size_t rows = _rows();
+		size_t width = std::max(info.width, 0);
+
+		for (size_t r = rows - count; r < rows; r++) {
+			wmove(_main, r, 0);
+			wclrtoeol(_main);
+
+			// Line shown on this row, if it is kept
+			if (end < rows - r)
+				continue;
+
+			uint64_t seq = end - (rows - r);
+			if (seq < _ring.first() || seq >= _ring.total())
+				continue;
+
+			std::string_view line = _ring[seq - _ring.first()];
+			_add_text(line.substr(0, DisplayWidth::prefix(line, width)));
+		}
+	}
+};
+
+// Channel for lines logged from other threads, drained by the
+//	thread which owns the window; every producer gets its own
+//	single producer ring of fixed size slots, so logging takes no
+//	lock and never waits. When a ring is full the new line is
+//	dropped, or the oldest one overwritten, as chosen; draining
+//	merges the rings by the time the lines were logged
+class LogChannel {
+public:
+	// What to do with a line logged into a full ring
+	enum class Policy {
+		drop,
+		overwrite
+	};
+
+	// Bytes of text a slot holds, longer lines are cut
+	static constexpr size_t slot_text = 240;
+
+	// A line as logged, in nanoseconds of the steady clock
+	struct Record {
+		uint64_t time;
+		std::string_view text;
+	};
+protected:
+	// Slots are written and read a word at a time through relaxed
+	//	atomics, as the consumer may copy a slot which a producer
+	//	is overwriting (and then discard the copy)
+	struct Slot {
+		std::atomic <uint64_t> time;
+		std::atomic <uint32_t> length;
+		std::atomic <uint64_t> words[slot_text / 8];
+
+		void store(const char *text, size_t n) {
+			for (size_t i = 0; i < n; i += 8) {
+				uint64_t word = 0;
+				std::memcpy(&word, text + i, std::min <size_t> (n - i, 8));
+				words[i / 8].store(word, std::memory_order_relaxed);
+			}
+
+			length.store(n, std::memory_order_relaxed);
+		}
+
+		// Append the text to a string, returns its length
+		size_t load(std::string &out) const {
+			size_t n = std::min <size_t> (length.load(std::memory_order_relaxed), slot_text);
+			for (size_t i = 0; i < n; i += 8) {
+				uint64_t word = words[i / 8].load(std::memory_order_relaxed);
+				out.append((const char *) &word, std::min <size_t> (n - i, 8));
+			}
+
+			return n;
+		}
+	};
+
+	// The consumer takes slots by moving the tail with a compare
+	//	and swap, after copying them; a producer overwriting moves
+	//	the tail first, so a slot copied while being overwritten
+	//	fails the swap and is discarded
+	struct Ring {
+		alignas(64) std::atomic <uint64_t> head {0};
+		alignas(64) std::atomic <uint64_t> tail {0};
+		alignas(64) std::atomic <uint64_t> lost {0};
+		std::atomic <bool> closed {false};
+
+		std::unique_ptr <Slot[]> slots;
+		size_t mask;
+		Policy policy;
+
+		Ring(size_t capacity, Policy p) : policy(p) {
+			size_t size = 1;
+			while (size < capacity)
+				size <<= 1;
+
+			slots.reset(new Slot[size]);
+			mask = size - 1;
+		}
+	};
+public:
+	// Handle of a producer thread, not to be shared between threads
+	class Producer {
+	public:
+		Producer() = default;
+
+		Producer(Producer &&) = default;
+		Producer &operator=(Producer &&other) {
+			close();
+			_ring = std::move(other._ring);
+			return *this;
+		}
+
+		~Producer() {
+			close();
+		}
 
-				// Pad string with spaces
-				str = str.substr(0, _lengths[i]);
-				if (str.length() < _lengths[i])
-					str.append(std::string(_lengths[i] - str.length(), ' '));
+		// Log a line, false if it was dropped (or the producer
+		//	is closed)
+		bool log(std::string_view text) {
+			Slot *slot = _claim();
+			if (!slot)
+				return false;
 
-				// Highlight if needed
-				if (n == highlight)
-					wattrset(_main, A_REVERSE);
+			slot->store(text.data(), std::min(text.size(), slot_text));
+			_publish(slot);
+			return true;
+		}
 
-				mvprintf(line, x, " %s ", str.c_str());
+		// Log a formatted line
+		template <typename ... Args>
+		bool printf(const char *str, Args ... args) {
+			Slot *slot = _claim();
+			if (!slot)
+				return false;
 
-				if (n == highlight)
-					wattrset(_main, A_NORMAL);
+			char text[slot_text];
+			int n = std::snprintf(text, slot_text, str, args...);
+			slot->store(text, std::min <size_t> (std::max(n, 0), slot_text - 1));
 
-				// Normal
-				x += _lengths[i] + 3;
-				mvadd_char(line, x - 1, ACS_VLINE);
-			}
-			mvadd_char(line, 0, ACS_VLINE);
-			line++;
+			_publish(slot);
+			return true;
 		}
 
-		// Write the bottom bar
-		x = 0;
+		// Stop logging, the lines logged are still drained
+		void close() {
+			if (_ring)
+				_ring->closed.store(true, std::memory_order_release);
 
-		mvadd_char(line, 0, ACS_LLCORNER);
-		for (size_t i = 0; i < _headers.size(); i++) {
-			for (int j = 0; j < _lengths[i] + 2; j++)
-				mvadd_char(line, x + j + 1, ACS_HLINE);
-			x += _lengths[i] + 3;
+			_ring.reset();
+		}
+	protected:
+		std::shared_ptr <Ring> _ring;
 
-			if (i != _headers.size() - 1)
-				mvadd_char(line, x, ACS_BTEE);
-			else
-				mvadd_char(line, x, ACS_LRCORNER);
+		Producer(std::shared_ptr <Ring> ring) : _ring(std::move(ring)) {}
+
+		// Slot at the head, nullptr if the line is dropped
+		Slot *_claim() {
+			if (!_ring)
+				return nullptr;
+
+			Ring &ring = *_ring;
+			uint64_t head = ring.head.load(std::memory_order_relaxed);
+			uint64_t tail = ring.tail.load(std::memory_order_acquire);
+
+			if (head - tail > ring.mask) {
+				// Take the oldest slot from the consumer, unless
+				//	it has just taken it itself
+				bool lost = ring.policy == Policy::drop
+					|| ring.tail.compare_exchange_strong(tail, tail + 1,
+						std::memory_order_acq_rel);
+
+				if (lost)
+					ring.lost.fetch_add(1, std::memory_order_relaxed);
+
+				if (ring.policy == Policy::drop)
+					return nullptr;
+			}
+
+			return &ring.slots[head & ring.mask];
 		}
-		line++;
-	}
-public:
-	// Default constructor
-	Table() = default;
 
-	// Constructors
-	// TODO: auto resize window
-	Table(const From &from, int height, int width, int y, int x)
-			: PlainWindow(height, width, y, x),
-			_headers(from.headers), _data(from.data),
-			_generator(from.generator), _lengths(from.lengths) {
-		// Get lengths (auto)
-		if (_lengths.empty())
-			_get_lengths();
+		void _publish(Slot *slot) {
+			slot->time.store(std::chrono::duration_cast <std::chrono::nanoseconds> (
+				std::chrono::steady_clock::now().time_since_epoch()).count(),
+				std::memory_order_relaxed);
 
-		// Resize window if requested
-		if (from.auto_resize) {
-			int new_height = _data.size() + 4;
-			int new_width = 1;
-			for (const auto &l : _lengths)
-				new_width += l + 3;
-			resize(new_height, new_width);
+			Ring &ring = *_ring;
+			ring.head.store(ring.head.load(std::memory_order_relaxed) + 1,
+				std::memory_order_release);
 		}
 
-		// Write table
-		_write_table();
+		friend class LogChannel;
+	};
 
-		// Refresh all boxes
-		wrefresh(_main);
+	// Constructor, with the slots per producer and the policy
+	LogChannel(size_t capacity = 4096, Policy policy = Policy::drop)
+			: _capacity(capacity), _policy(policy) {}
+
+	// Ring for the calling thread (which only locks here)
+	Producer producer() {
+		return producer(_capacity, _policy);
 	}
 
-	Table(const From &from, const ScreenInfo &info)
-			: Table(from,
-				info.height, info.width,
-				info.y, info.x
-			) {}
+	Producer producer(size_t capacity, Policy policy) {
+		auto ring = std::make_shared <Ring> (capacity, policy);
 
-	// Update data
-	void set_data(const Data &data, bool auto_resize = false) {
-		// First, erase
-		erase();
+		std::lock_guard <std::mutex> guard(_lock);
+		_rings.push_back(ring);
+		return Producer(ring);
+	}
 
-		_data = data;
+	// Lines dropped or overwritten so far
+	uint64_t lost() const {
+		std::lock_guard <std::mutex> guard(_lock);
 
-		if (auto_resize) {
-			_lengths.clear();
-			_get_lengths();
-			resize(_data.size() + 4, 1);
-		}
+		uint64_t lost = _closed_lost;
+		for (const auto &ring : _rings)
+			lost += ring->lost.load(std::memory_order_relaxed);
 
-		_write_table();
-		wrefresh(_main);
+		return lost;
 	}
 
-	// Update lengths
-	void set_lengths(const Lengths &lengths) {
-		// First, erase
-		erase();
+	// Pass the lines logged since the last drain to a sink, in
+	//	the order they were logged, returns the number passed
+	template <class Sink>
+	size_t drain(Sink &&sink) {
+		_take();
+
+		// Merge the runs of the rings, each in order already
+		using Head = std::pair <uint64_t, size_t>;
+		std::vector <Head> heap;
+		for (size_t r = 0; r < _runs.size(); r++) {
+			if (_runs[r].first < _runs[r].second)
+				heap.emplace_back(_items[_runs[r].first].time, r);
+		}
 
-		_lengths = lengths;
-		_write_table();
-		wrefresh(_main);
-	}
+		auto later = std::greater <Head> ();
+		std::make_heap(heap.begin(), heap.end(), later);
 
-	// Set the generator
-	void set_generator(const Generator &generator) {
-		// First, erase
-		erase();
+		size_t count = 0;
+		while (!heap.empty()) {
+			std::pop_heap(heap.begin(), heap.end(), later);
+			size_t r = heap.back().second;
 
-		_generator = generator;
-		_write_table();
-		wrefresh(_main);
+			const Item &item = _items[_runs[r].first++];
+			sink(Record {item.time,
+				std::string_view(_text.data() + item.offset, item.length)});
+			count++;
+
+			if (_runs[r].first < _runs[r].second) {
+				heap.back().first = _items[_runs[r].first].time;
+				std::push_heap(heap.begin(), heap.end(), later);
+			} else {
+				heap.pop_back();
+			}
+		}
+
+		return count;
 	}
 
-	// Highlight a row
-	void highlight_row(int row) {
-		// First, erase
-		erase();
-		_write_table(row);
-		wrefresh(_main);
+	// Drain into a log view
+	size_t drain(LogView &view) {
+		return drain([&](const Record &record) {
+			view.append(record.text);
+		});
+	}
+protected:
+	size_t _capacity;
+	Policy _policy;
+
+	mutable std::mutex _lock;
+	std::vector <std::shared_ptr <Ring>> _rings;
+	uint64_t _closed_lost = 0;
+
+	// Lines taken from the rings, as runs of items per ring
+	struct Item {
+		uint64_t time;
+		size_t offset;
+		uint32_t length;
+	};
+
+	std::vector <Item> _items;
+	std::vector <std::pair <size_t, size_t>> _runs;
+	std::string _text;
+
+	// Copy the published lines out of every ring
+	void _take() {
+		_items.clear();
+		_runs.clear();
+		_text.clear();
+
+		std::lock_guard <std::mutex> guard(_lock);
+		for (size_t r = 0; r < _rings.size(); r++) {
+			Ring &ring = *_rings[r];
+
+			// Check before taking, lines published before the
+			//	close are still taken
+			bool closed = ring.closed.load(std::memory_order_acquire);
+
+			size_t begin = _items.size();
+			uint64_t tail = ring.tail.load(std::memory_order_acquire);
+			uint64_t head = ring.head.load(std::memory_order_acquire);
+			while (tail < head) {
+				const Slot &slot = ring.slots[tail & ring.mask];
+
+				size_t offset = _text.size();
+				Item item {slot.time.load(std::memory_order_relaxed), offset, 0};
+				item.length = slot.load(_text);
+
+				if (ring.tail.compare_exchange_strong(tail, tail + 1,
+						std::memory_order_acq_rel)) {
+					_items.push_back(item);
+					tail++;
+				} else {
+					// Overwritten while copying
+					_text.resize(offset);
+				}
+			}
+
+			_runs.emplace_back(begin, _items.size());
+
+			if (closed) {
+				_closed_lost += ring.lost.load(std::memory_order_relaxed);
+				_rings.erase(_rings.begin() + r);
+				r--;
+			}
+		}
 	}
 };
 
-// Yielders for upcoming FieldEditor class
-struct base_yielder {
-	enum class Ret {
-		RET_NOP,
-		RET_PLUS,
-		RET_DEL
+// Word wrapping of a text into lines of a width in columns, as
+//	counted by DisplayWidth; the lines of a paragraph are computed
+//	when first asked for at a width and cached with it, so laying
+//	out a long text costs only the paragraphs looked at, and a new
+//	width reflows only those
+class TextLayout {
+public:
+	// Wrapped line, as bytes of the text
+	struct Line {
+		size_t offset;
+		size_t length;
 	};
 
-	virtual Ret proc(int) {
-		return Ret::RET_NOP;
+	// Default constructor, an empty text still has a paragraph
+	TextLayout() {
+		assign("");
 	}
 
-	virtual std::string content() {
-		return "";
+	// Constructor
+	TextLayout(std::string text) {
+		assign(std::move(text));
 	}
-};
 
-template <class T>
-struct Tyielder : public base_yielder {
-	T *value;
+	// Replace the text, dropping every cached layout
+	void assign(std::string text) {
+		_text = std::move(text);
+		_version++;
 
-	Tyielder(T *ptr) : value(ptr) {}
-};
+		_paragraphs.clear();
+		size_t start = 0;
+		while (true) {
+			size_t end = _text.find('\n', start);
+			if (end == std::string::npos)
+				end = _text.size();
 
-using Yielder = std::shared_ptr <base_yielder>;
+			_paragraphs.push_back(Paragraph {start, end - start, 0, {}});
+			if (end == _text.size())
+				break;
 
-// Specializations
-template <>
-struct Tyielder <std::string> : public base_yielder {
-	std::string *value;
+			start = end + 1;
+		}
+	}
 
-	Tyielder(std::string *ptr) : value(ptr) {}
+	const std::string &text() const {
+		return _text;
+	}
 
-	Ret proc(int ch) override {
-		if (ch == KEY_BACKSPACE) {
-			if (!value->empty()) {
-				value->pop_back();
-				return Ret::RET_DEL;
-			}
+	// Changes with every assign
+	uint64_t version() const {
+		return _version;
+	}
 
-			return Ret::RET_NOP;
-		} else if (std::isprint(ch)) {
-			*value += ch;
-			return Ret::RET_PLUS;
+	size_t paragraphs() const {
+		return _paragraphs.size();
+	}
+
+	// Lines of a paragraph at a width, an empty paragraph has
+	//	a single empty line
+	const std::vector <Line> &lines(size_t paragraph, size_t width) {
+		Paragraph &p = _paragraphs[paragraph];
+		width = std::max <size_t> (width, 1);
+
+		if (p.width != width) {
+			p.width = width;
+			p.lines.clear();
+			_wrap(p.offset, p.length, width, p.lines);
 		}
 
-		return Ret::RET_NOP;
+		return p.lines;
 	}
 
-	std::string content() override {
-		return *value;
+	std::string_view line_text(const Line &line) const {
+		return std::string_view(_text).substr(line.offset, line.length);
 	}
-};
+protected:
+	// Paragraph, with its lines at the width they are for (or
+	//	none, if it was not laid out yet)
+	struct Paragraph {
+		size_t offset;
+		size_t length;
+		size_t width = 0;
+		std::vector <Line> lines;
+	};
 
-// Factory for Yielder
-template <class T>
-inline Yielder yielder(T *value)
-{
-	return std::shared_ptr <base_yielder>
-		(new Tyielder <T> {value});
-}
+	std::string _text;
+	uint64_t _version = 0;
+	std::vector <Paragraph> _paragraphs;
+
+	// Greedy wrapping: break at the last space which fits, drop
+	//	the spaces at the break, and cut words wider than a line
+	void _wrap(size_t offset, size_t length, size_t width, std::vector <Line> &lines) const {
+		const char *text = _text.data();
+		size_t end = offset + length;
+
+		size_t start = offset;
+		while (true) {
+			size_t cols = 0;
+			size_t i = start;
+			size_t space = std::string::npos;
+			bool word = false;
+
+			// Fit as many characters as the width allows, noting
+			//	the last space after a word; a line takes at
+			//	least one character, however wide
+			std::string_view rest(text + start, end - start);
+			while (i < end) {
+				size_t w = 1;
+				size_t length = 1;
+				if (text[i] & 0x80) {
+					char32_t cp;
+					length = DisplayWidth::decode(rest, i - start, cp);
+					w = length ? DisplayWidth::of(cp) : 1;
+					length = std::max <size_t> (length, 1);
+				}
 
-// Field editor window
-class FieldEditor : public DecoratedWindow {
-public:
-	// Aliases
-	using Fields = std::vector <std::string>;
-protected:
-	Fields _fields;
+				if (cols + w > width && i > start)
+					break;
 
-	// Quit flag
-	bool _quit = false;
-	bool _escape = false;
+				if (text[i] != ' ')
+					word = true;
+				else if (word)
+					space = i;
 
-	// Check movement input
-	bool _check_movement_input(int c, int &field) {
-		switch (c) {
-		case KEY_UP:
-			if (field > 0)
-				field--;
-			return true;
-		case KEY_DOWN:
-			if (field < _fields.size())
-				field++;
-			return true;
-		case 10: // Enter key
-			if (field == _fields.size())
-				_quit = true;
-			return true;
-		case '\t':
-			// Cycle through fields
-			if (field == _fields.size())
-				field = 0;
-			else
-				field++;
+				cols += w;
+				i += length;
+			}
 
-			return true;
-		case 27: // Escape key
-			_escape = true;
-			_quit = true;
-			return true;
-		default:
-			break;
-		}
+			// Break after the last word which fits, if any
+			size_t stop = i;
+			if (i < end && text[i] != ' ' && space != std::string::npos)
+				stop = space;
 
-		return false;
-	}
+			size_t trimmed = stop;
+			while (trimmed > start && text[trimmed - 1] == ' ' && stop < end)
+				trimmed--;
 
-	// Print ok button
-	void _print_ok(bool highlight) {
-		if (highlight)
-			attribute_set(A_REVERSE);
+			lines.push_back(Line {start, trimmed - start});
+			if (stop >= end)
+				break;
 
-		mvprintf(info.height - 6, info.width / 2 - 4, "[ OK ]");
+			// The next line starts after the spaces at the break
+			start = stop;
+			while (start < end && text[start] == ' ')
+				start++;
 
-		if (highlight)
-			attribute_set(A_NORMAL);
+			if (start == end)
+				break;
+		}
 	}
+};
 
-	// Update field
-	void _update_field(int field, const std::vector <Yielder> &yielders) {
-		// Substring to print
-		std::string substr = yielders[field]->content();
-
-		// Check if scrolling is needed
-		size_t l = _fields[field].size() + 1
-			+ yielders[field]->content().size();
+// Window showing a long text wrapped at words, such as help; the
+//	position is kept as a paragraph and a line in it, so that only
+//	the paragraphs in view are laid out, when drawing or after the
+//	window is resized
+class TextView : public PlainWindow {
+public:
+	// Constructor
+	TextView(const ScreenInfo &info, std::string text = "")
+			: PlainWindow(info), _layout(std::move(text)) {
+		keypad(_main, true);
+	}
 
-		if (l + 5 > info.width) {
-			// Scroll by taking substring
-			size_t offset = (l + 4) - info.width;
-			substr = yielders[field]->content().substr(offset);
-		}
+	void set_text(std::string text) {
+		_layout.assign(std::move(text));
+		_paragraph = _line = 0;
+	}
 
-		// First clear the field's line
-		cursor(field, 0);
-		wclrtoeol(_main);
+	TextLayout &layout() {
+		return _layout;
+	}
 
-		// Reprint the field line
-		mvprintf(field, 0, "%s  %s",
-			_fields[field].c_str(),
-			substr.c_str()
-		);
+	// First paragraph in view, and its first line in view
+	std::pair <size_t, size_t> position() const {
+		return std::make_pair(_paragraph, _line);
 	}
-public:
-	// Default constructor
-	FieldEditor() = default;
 
-	// Constructor
-	// TODO: remove screeninfo parameter (make a separate constructor)
-	FieldEditor(const std::string &title, const Fields &fnames,
-			const ScreenInfo &info)
-			: DecoratedWindow(title, info), _fields(fnames) {
-		// Pad all fields with spaces
-		size_t max_len = 0;
-		for (const auto &f : _fields)
-			max_len = std::max(max_len, f.size());
+	// Move the view by some lines, down if positive
+	void scroll_by(long lines) {
+		size_t width = _width();
 
-		for (auto &f : _fields)
-			f.resize(max_len + 2, ' ');
+		for (; lines > 0; lines--) {
+			size_t count = _layout.lines(_paragraph, width).size();
+			if (_line + 1 < count)
+				_line++;
+			else if (_paragraph + 1 < _layout.paragraphs())
+				_paragraph++, _line = 0;
+			else
+				break;
+		}
 
-		// Write the fields
-		int line = 0;
-		for (const auto &f : _fields) {
-			mvprintf(line, 0, "%s ", f.c_str());
-			line++;
+		for (; lines < 0; lines++) {
+			if (_line > 0)
+				_line--;
+			else if (_paragraph > 0)
+				_line = _layout.lines(--_paragraph, width).size() - 1;
+			else
+				break;
 		}
 
-		// Add [ OK ] button
-		_print_ok(false);
+		_clamp();
 	}
 
-	// Yield the fields
-	// TODO: print error message if some conditions are not met
-	// (condition functions passed as another object -- input is the list of
-	// yeidlers)
-	bool yield(const std::vector <Yielder> &yielders) {
-		// Field index
-		int field = 0;
+	void home() {
+		_paragraph = _line = 0;
+	}
 
-		// Set keyboard input
-		keypad(_main, true);
+	// Last page, laying out the last paragraphs only
+	void end() {
+		_paragraph = _layout.paragraphs() - 1;
+		_line = _layout.lines(_paragraph, _width()).size() - 1;
+		scroll_by(1 - (long) _height());
+	}
 
-		// Turn off echo
-		noecho();
+	// Handle a scrolling key, false if it is not one
+	bool handle_key(int c) {
+		long page = _height();
+		switch (c) {
+		case KEY_UP:
+			scroll_by(-1);
+			break;
+		case KEY_DOWN:
+			scroll_by(1);
+			break;
+		case KEY_PPAGE:
+			scroll_by(-page);
+			break;
+		case KEY_NPAGE:
+			scroll_by(page);
+			break;
+		case KEY_HOME:
+			home();
+			break;
+		case KEY_END:
+			end();
+			break;
+		default:
+			return false;
+		}
 
-		// Update all fields
-		for (int i = 0; i < _fields.size(); i++)
-			_update_field(i, yielders);
+		return true;
+	}
 
-		// Move cursor
-		cursor(0, _fields[0].size() + 2
-			+ yielders[0]->content().size());
-		curs_set(1);
+	// Draw the lines in view, at the current size of the window
+	void draw() {
+		size_t width = _width();
+		size_t height = _height();
 
-		// Get the fields
-		int c;
-		while ((c = getc())) {
-			// Check for movement inputs
-			bool moved = _check_movement_input(c, field);
+		werase(_main);
+		_clamp();
+
+		std::string text;
+		size_t p = _paragraph;
+		size_t l = _line;
+		for (size_t row = 0; row < height && p < _layout.paragraphs(); row++) {
+			const auto &lines = _layout.lines(p, width);
+
+			text.assign(_layout.line_text(lines[l]));
+			for (auto &c : text) {
+				if (c == '\t' || (unsigned char) c < 32 || c == 127)
+					c = ' ';
+			}
 
-			// Check for quit
-			if (_quit)
-				break;
+			mvwaddnstr(_main, row, 0, text.data(), text.size());
 
-			// Highlight the ok button if needed
-			if (field >= _fields.size()) {
-				curs_set(0);
-				_print_ok(true);
-				continue;
-			} else {
-				curs_set(1);
-				_print_ok(false);
-			}
+			if (++l == lines.size())
+				p++, l = 0;
+		}
 
-			// Cursor position
-			size_t l = _fields[field].size() + 2
-				+ yielders[field]->content().size();
+		refresh();
+	}
+protected:
+	TextLayout _layout;
 
-			// Move the cursor
-			cursor(field, _fields[field].size() + 2
-				+ yielders[field]->content().size());
+	// Position in view
+	size_t _paragraph = 0;
+	size_t _line = 0;
 
-			// Skip if moved
-			if (moved)
-				continue;
+	// A wider window leaves fewer lines in the first paragraph
+	void _clamp() {
+		_line = std::min(_line, _layout.lines(_paragraph, _width()).size() - 1);
+	}
 
-			// Yield the field
-			auto ret = yielders[field]->proc(c);
-			if (ret != base_yielder::Ret::RET_NOP) {
-				// Update the field
-				_update_field(field, yielders);
-			}
-		}
+	size_t _width() const {
+		int height, width;
+		getmaxyx(_main, height, width);
+		(void) height;
 
-		// Disable cursor
-		curs_set(0);
+		return std::max(width, 1);
+	}
 
-		return (!_escape);
+	size_t _height() const {
+		int height, width;
+		getmaxyx(_main, height, width);
+		(void) width;
+
+		return std::max(height, 1);
 	}
 };
 